@@ -0,0 +1,72 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include "tetris/ai.hpp"
+#include "tetris/engine.hpp"
+
+/**
+ * Lets the placement-search agent play N seeded games and reports search
+ * throughput and how well it played. Weights are optional and scaled by 1000.
+ * Usage: ai_bench [games] [seed] [max_pieces] [height lines holes bumpiness]
+ */
+
+int main(const int argc, char** argv) {
+    const uint32_t games = argc > 1 ? strtoul(argv[1], nullptr, 0) : 10;
+    const uint32_t seed = argc > 2 ? strtoul(argv[2], nullptr, 0) : 1;
+    const uint32_t max_pieces = argc > 3 ? strtoul(argv[3], nullptr, 0) : 1000;
+
+    AiWeights weights = AI_DEFAULT_WEIGHTS;
+    if (argc > 7) {
+        weights.aggregate_height = strtol(argv[4], nullptr, 0);
+        weights.lines = strtol(argv[5], nullptr, 0);
+        weights.holes = strtol(argv[6], nullptr, 0);
+        weights.bumpiness = strtol(argv[7], nullptr, 0);
+    }
+
+    uint64_t nodes = 0, actions = 0, pieces = 0, lines = 0, score = 0, game_overs = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < games; i++) {
+        TetrisEngine engine;
+        TetrisAi ai;
+        ai.set_weights(weights);
+        engine.reset(seed + i);
+
+        const uint32_t first_piece = engine.get_piece_count();
+        while (engine.get_piece_count() - first_piece < max_pieces) {
+            const Action action = ai.next_action(engine);
+            if (action == ACTION_RESTART) {
+                game_overs++;
+                break;
+            }
+
+            engine.apply(action);
+            engine.tick();
+            actions++;
+        }
+
+        nodes += ai.get_nodes();
+        pieces += engine.get_piece_count() - first_piece;
+        lines += engine.get_full_lines();
+        score += engine.get_score();
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    const double secs = std::chrono::duration<double>(end - start).count();
+
+    printf("games:       %u (seed %u, %llu topped out)\n", games, seed, static_cast<unsigned long long>(game_overs));
+    printf("weights:     height %d, lines %d, holes %d, bumpiness %d\n",
+           weights.aggregate_height, weights.lines, weights.holes, weights.bumpiness);
+    printf("pieces:      %llu\n", static_cast<unsigned long long>(pieces));
+    printf("lines:       %llu (%.2f per piece)\n", static_cast<unsigned long long>(lines),
+           pieces ? static_cast<double>(lines) / pieces : 0.0);
+    printf("avg score:   %.0f\n", games ? static_cast<double>(score) / games : 0.0);
+    printf("actions:     %llu\n", static_cast<unsigned long long>(actions));
+    printf("nodes:       %llu\n", static_cast<unsigned long long>(nodes));
+    printf("elapsed:     %.3f s\n", secs);
+    printf("nodes/s:     %.0f\n", nodes / secs);
+    printf("pieces/s:    %.0f\n", pieces / secs);
+    return 0;
+}
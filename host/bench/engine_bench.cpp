@@ -0,0 +1,120 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "tetris/engine.hpp"
+
+/**
+ * Plays N games from seeded piece sequences with scripted inputs and reports
+ * engine throughput. Usage: engine_bench [games] [seed] [max_pieces]
+ */
+
+static uint64_t allocations = 0;
+
+void* operator new(const size_t size) {
+    allocations++;
+    if (void* p = malloc(size)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+struct ScriptRng {
+    uint64_t state;
+
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return static_cast<uint32_t>(state >> 32);
+    }
+};
+
+struct GameResult {
+    uint64_t moves;
+    uint64_t ticks;
+    uint64_t pieces;
+    uint32_t lines;
+    uint32_t score;
+};
+
+// Apply one scripted action, followed by one simulation frame
+static void step(TetrisEngine& engine, const Action action, GameResult& result) {
+    engine.apply(action);
+    engine.tick();
+    result.moves++;
+    result.ticks++;
+}
+
+static GameResult play_game(const uint32_t seed, const uint32_t max_pieces) {
+    TetrisEngine engine;
+    ScriptRng script{0x9E3779B97F4A7C15ull ^ seed};
+    GameResult result = {};
+
+    engine.reset(seed);
+    step(engine, ACTION_START, result);
+
+    while (engine.get_state() == STATE_ACTIVE && result.pieces < max_pieces) {
+        const uint32_t r = script.next();
+
+        const uint32_t rotations = r & 3;
+        for (uint32_t i = 0; i < rotations; i++) step(engine, ACTION_ROTATE_CW, result);
+
+        const int32_t shift = static_cast<int32_t>((r >> 2) % 11) - 5;
+        const Action dir = shift < 0 ? ACTION_MOVE_LEFT : ACTION_MOVE_RIGHT;
+        for (int32_t i = 0; i < (shift < 0 ? -shift : shift); i++) step(engine, dir, result);
+
+        const uint32_t soft_drops = (r >> 8) & 3;
+        for (uint32_t i = 0; i < soft_drops; i++) step(engine, ACTION_SOFT_DROP, result);
+
+        step(engine, ACTION_HARD_DROP, result);
+        result.pieces++;
+    }
+
+    result.lines = engine.get_full_lines();
+    result.score = engine.get_score();
+    return result;
+}
+
+int main(const int argc, char** argv) {
+    const uint32_t games = argc > 1 ? strtoul(argv[1], nullptr, 0) : 1000;
+    const uint32_t seed = argc > 2 ? strtoul(argv[2], nullptr, 0) : 1;
+    const uint32_t max_pieces = argc > 3 ? strtoul(argv[3], nullptr, 0) : 10000;
+
+    GameResult total = {};
+    uint64_t score_sum = 0;
+    const uint64_t allocations_before = allocations;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < games; i++) {
+        const GameResult r = play_game(seed + i, max_pieces);
+        total.moves += r.moves;
+        total.ticks += r.ticks;
+        total.pieces += r.pieces;
+        total.lines += r.lines;
+        score_sum += r.score;
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    const double secs = std::chrono::duration<double>(end - start).count();
+
+    printf("games:          %u (seed %u)\n", games, seed);
+    printf("moves:          %llu\n", static_cast<unsigned long long>(total.moves));
+    printf("ticks:          %llu\n", static_cast<unsigned long long>(total.ticks));
+    printf("pieces:         %llu\n", static_cast<unsigned long long>(total.pieces));
+    printf("lines:          %u\n", total.lines);
+    printf("score checksum: %llu\n", static_cast<unsigned long long>(score_sum));
+    printf("elapsed:        %.3f s\n", secs);
+    printf("moves/s:        %.0f\n", total.moves / secs);
+    printf("lines/s:        %.0f\n", total.lines / secs);
+    printf("allocations:    %llu\n", static_cast<unsigned long long>(allocations - allocations_before));
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "lib/fmt.hpp"
+#include "lib/format.hpp"
+
+/**
+ * Formats typical kernel log and HUD lines with the va_list vformat_to and
+ * the compile-time fmt::format_to, checks that both print the same text and
+ * reports the time per line. Usage: format_bench [iterations]
+ */
+
+#define LINE_SIZE 128
+
+// Keeps the formatting from being optimized away
+static volatile uint64_t checksum_sink;
+
+template <typename F>
+static double measure(const uint64_t iterations, F&& line) {
+    char buf[LINE_SIZE];
+    uint64_t checksum = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < iterations; i++) {
+        checksum += line(buf, i);
+        checksum += static_cast<unsigned char>(buf[i % 8]);
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    checksum_sink = checksum;
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+template <typename Old, typename New>
+static bool bench(const char* name, const uint64_t iterations, Old&& old_line, New&& new_line) {
+    // Both must agree before their speed means anything
+    char a[LINE_SIZE], b[LINE_SIZE];
+    static const uint64_t samples[] = {0, 7, 123456789, 0xFFFFFFFF};
+    for (const uint64_t i : samples) {
+        const size_t la = old_line(a, i);
+        const size_t lb = new_line(b, i);
+        if (la != lb || strcmp(a, b) != 0) {
+            fprintf(stderr, "%s: mismatch for %llu:\n  vformat: \"%s\" (%zu)\n  fmt:     \"%s\" (%zu)\n",
+                    name, static_cast<unsigned long long>(i), a, la, b, lb);
+            return false;
+        }
+    }
+
+    const double old_ns = measure(iterations, old_line);
+    const double new_ns = measure(iterations, new_line);
+    printf("%-8s vformat %7.1f ns/line, fmt %7.1f ns/line (%.2fx)\n", name, old_ns, new_ns, old_ns / new_ns);
+    return true;
+}
+
+int main(const int argc, char** argv) {
+    const uint64_t iterations = argc > 1 ? strtoull(argv[1], nullptr, 0) : 2000000;
+    bool ok = true;
+
+    ok &= bench("hud", iterations,
+        [](char* buf, const uint64_t i) -> size_t {
+            return format_to(buf, LINE_SIZE, "TIME: %02d:%02d", static_cast<int>(i / 60 % 100), static_cast<int>(i % 60));
+        },
+        [](char* buf, const uint64_t i) -> size_t {
+            return fmt::format_to(buf, LINE_SIZE, FMT("TIME: %02d:%02d"), static_cast<int>(i / 60 % 100), static_cast<int>(i % 60));
+        });
+
+    ok &= bench("log", iterations,
+        [](char* buf, const uint64_t i) -> size_t {
+            return format_to(buf, LINE_SIZE, "AI: %lu nodes in %lu cycles (%lu cycles/node)", i * 37, i * 1000003, i % 977);
+        },
+        [](char* buf, const uint64_t i) -> size_t {
+            return fmt::format_to(buf, LINE_SIZE, FMT("AI: %lu nodes in %lu cycles (%lu cycles/node)"), i * 37, i * 1000003, i % 977);
+        });
+
+    ok &= bench("mixed", iterations,
+        [](char* buf, const uint64_t i) -> size_t {
+            return format_to(buf, LINE_SIZE, "%s: vector %d at 0x%lx, %-6s|%5d", "IRQ", static_cast<int>(i % 256) - 128, i << 12, "ok", static_cast<int>(i % 1000));
+        },
+        [](char* buf, const uint64_t i) -> size_t {
+            return fmt::format_to(buf, LINE_SIZE, FMT("%s: vector %d at 0x%lx, %-6s|%5d"), "IRQ", static_cast<int>(i % 256) - 128, i << 12, "ok", static_cast<int>(i % 1000));
+        });
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,60 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "tetris/engine.hpp"
+#include "tetris/perft.hpp"
+
+/**
+ * Counts the lock positions reachable on an empty board for each depth up to
+ * max_depth, placing the pieces of the queue in order. The default queue has
+ * known counts, so a change in them means move generation changed.
+ * Usage: perft [max_depth] [queue]
+ */
+
+#define DEFAULT_QUEUE "TIOLJSZ"
+
+// Node counts for DEFAULT_QUEUE, index = depth
+static const uint64_t KNOWN_COUNTS[] = {1, 34, 596, 5542, 198763, 7335479};
+
+int main(const int argc, char** argv) {
+    const uint32_t max_depth = argc > 1 ? strtoul(argv[1], nullptr, 0) : 3;
+    const char* queue_str = argc > 2 ? argv[2] : DEFAULT_QUEUE;
+
+    uint8_t queue[PERFT_MAX_DEPTH];
+    const int queue_len = perft_parse_queue(queue_str, queue, PERFT_MAX_DEPTH);
+    if (queue_len < 0) {
+        fprintf(stderr, "bad queue '%s', expected letters from IJTLOZS\n", queue_str);
+        return 1;
+    }
+    if (max_depth > static_cast<uint32_t>(queue_len)) {
+        fprintf(stderr, "depth %u needs at least %u pieces in the queue\n", max_depth, max_depth);
+        return 1;
+    }
+
+    const bool check = strcmp(queue_str, DEFAULT_QUEUE) == 0;
+    const TetrisEngine engine;
+    bool ok = true;
+
+    printf("queue: %s\n", queue_str);
+    for (uint32_t depth = 1; depth <= max_depth; depth++) {
+        const auto start = std::chrono::steady_clock::now();
+        const uint64_t nodes = perft(engine, queue, depth);
+        const auto end = std::chrono::steady_clock::now();
+        const double secs = std::chrono::duration<double>(end - start).count();
+
+        printf("depth %u: %12llu nodes  %8.3f s  %12.0f nodes/s",
+               depth, static_cast<unsigned long long>(nodes), secs, secs > 0 ? nodes / secs : 0.0);
+
+        if (check && depth < sizeof(KNOWN_COUNTS) / sizeof(KNOWN_COUNTS[0])) {
+            const bool match = nodes == KNOWN_COUNTS[depth];
+            ok &= match;
+            printf("  %s", match ? "OK" : "MISMATCH");
+        }
+        printf("\n");
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,72 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "tetris/engine.hpp"
+#include "tetris/replay.hpp"
+
+/**
+ * Plays a replay log back into the engine as fast as possible and reports
+ * throughput. Every iteration must end in the same state since playback is
+ * deterministic. Usage: replay_bench <log> [iterations]
+ */
+
+int main(const int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <log> [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    FILE* f = fopen(argv[1], "rb");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    std::vector<uint8_t> log;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) log.insert(log.end(), chunk, chunk + n);
+    fclose(f);
+
+    const uint32_t iterations = argc > 2 ? strtoul(argv[2], nullptr, 0) : 1000;
+
+    ReplayResult first = {};
+    uint32_t first_score = 0;
+    uint64_t total_ticks = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        ReplayReader reader;
+        if (!reader.open(log.data(), log.size())) {
+            fprintf(stderr, "%s: not a replay log\n", argv[1]);
+            return 1;
+        }
+
+        TetrisEngine engine;
+        const ReplayResult result = replay_run(engine, reader);
+        total_ticks += result.ticks;
+
+        if (i == 0) {
+            first = result;
+            first_score = engine.get_score();
+        } else if (result.ticks != first.ticks || engine.get_score() != first_score) {
+            fprintf(stderr, "iteration %u diverged from the first playback\n", i);
+            return 1;
+        }
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    const double secs = std::chrono::duration<double>(end - start).count();
+
+    printf("log:        %zu bytes\n", log.size());
+    printf("events:     %llu\n", static_cast<unsigned long long>(first.events));
+    printf("ticks:      %llu\n", static_cast<unsigned long long>(first.ticks));
+    printf("score:      %u\n", first_score);
+    printf("iterations: %u\n", iterations);
+    printf("elapsed:    %.3f s\n", secs);
+    printf("ticks/s:    %.0f\n", total_ticks / secs);
+    return 0;
+}
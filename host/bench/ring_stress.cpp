@@ -0,0 +1,107 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "lib/ring.hpp"
+
+/**
+ * Hammers the SPSC and MPSC rings from real threads and checks that every
+ * item arrives exactly once and in order per producer. A small capacity keeps
+ * the rings wrapping and full most of the time. Build with -DTETROS_TSAN=ON
+ * to run it under ThreadSanitizer.
+ * Usage: ring_stress [items_per_producer] [producers]
+ */
+
+#define CAPACITY 64
+#define BATCH    7
+
+template <typename Ring>
+static void produce(Ring& ring, const uint64_t id, const uint64_t items, uint64_t& retries) {
+    uint64_t next = 0;
+    while (next < items) {
+        uint64_t batch[BATCH];
+        uint32_t n = 0;
+        // Alternate single pushes with batches so both paths see contention
+        const uint32_t want = next % 3 == 0 ? 1 : BATCH;
+        for (; n < want && next + n < items; n++) batch[n] = id << 32 | (next + n);
+
+        const uint32_t pushed = n == 1 ? ring.push(batch[0]) : ring.push_batch(batch, n);
+        next += pushed;
+        if (pushed < n) {
+            retries++;
+            std::this_thread::yield();
+        }
+    }
+}
+
+template <typename Ring>
+static bool consume(Ring& ring, const uint32_t producers, const uint64_t items) {
+    std::vector<uint64_t> expected(producers, 0);
+    uint64_t remaining = items * producers;
+
+    while (remaining) {
+        uint64_t batch[BATCH];
+        const uint32_t n = ring.pop_batch(batch, remaining % 2 ? 1 : BATCH);
+        if (n == 0) std::this_thread::yield();
+
+        for (uint32_t i = 0; i < n; i++) {
+            const uint64_t id = batch[i] >> 32;
+            const uint64_t seq = batch[i] & 0xFFFFFFFF;
+            if (id >= producers || seq != expected[id]) {
+                fprintf(stderr, "producer %llu: got item %llu, expected %llu\n",
+                        static_cast<unsigned long long>(id),
+                        static_cast<unsigned long long>(seq),
+                        static_cast<unsigned long long>(id < producers ? expected[id] : 0));
+                return false;
+            }
+            expected[id]++;
+        }
+        remaining -= n;
+    }
+
+    return ring.empty();
+}
+
+template <typename Ring>
+static bool run(const char* name, Ring& ring, const uint32_t producers, const uint64_t items) {
+    std::vector<uint64_t> retries(producers, 0);
+    std::vector<std::thread> threads;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < producers; i++) {
+        threads.emplace_back([&, i] { produce(ring, i, items, retries[i]); });
+    }
+    const bool ok = consume(ring, producers, items);
+    for (std::thread& t : threads) t.join();
+    const auto end = std::chrono::steady_clock::now();
+
+    uint64_t total_retries = 0;
+    for (const uint64_t r : retries) total_retries += r;
+
+    const double secs = std::chrono::duration<double>(end - start).count();
+    printf("%s: %u producer(s), %llu items in %.3f s (%.0f items/s), %llu full retries, %llu dropped: %s\n",
+           name,
+           producers,
+           static_cast<unsigned long long>(items * producers),
+           secs,
+           items * producers / secs,
+           static_cast<unsigned long long>(total_retries),
+           static_cast<unsigned long long>(ring.get_dropped()),
+           ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main(const int argc, char** argv) {
+    const uint64_t items = argc > 1 ? strtoull(argv[1], nullptr, 0) : 1000000;
+    const uint32_t producers = argc > 2 ? strtoul(argv[2], nullptr, 0) : 4;
+
+    static SpscRing<uint64_t, CAPACITY> spsc;
+    static MpscRing<uint64_t, CAPACITY> mpsc;
+
+    bool ok = run("spsc", spsc, 1, items);
+    ok &= run("mpsc", mpsc, producers, items);
+    return ok ? 0 : 1;
+}
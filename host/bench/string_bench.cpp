@@ -0,0 +1,224 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <initializer_list>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "lib/string.hpp"
+
+/**
+ * Checks the kernel string functions against glibc for every start offset
+ * and a range of lengths, with strings placed right before a PROT_NONE page
+ * so any read past the page they live in faults, then times both on short
+ * and long strings, with glibc (which may use SIMD) and the old byte loop for
+ * scale. Usage: string_bench [iterations]
+ */
+
+// glibc's versions, which the kernel ones share their names with
+extern "C" {
+    size_t libc_strlen(const char*) __asm__("strlen");
+    size_t libc_strnlen(const char*, size_t) __asm__("strnlen");
+    void* libc_memchr(const void*, int, size_t) __asm__("memchr");
+    char* libc_strchr(const char*, int) __asm__("strchr");
+    int libc_strcmp(const char*, const char*) __asm__("strcmp");
+    int libc_strncmp(const char*, const char*, size_t) __asm__("strncmp");
+}
+
+#define MAX_LEN 80
+
+static char* guarded_page;
+static size_t page_size;
+static uint64_t failures = 0;
+
+static int sign(const int v) {
+    return (v > 0) - (v < 0);
+}
+
+#define CHECK(cond, ...)                      \
+    do {                                      \
+        if (!(cond)) {                        \
+            if (failures++ < 10) {            \
+                fprintf(stderr, __VA_ARGS__); \
+                fputc('\n', stderr);          \
+            }                                 \
+        }                                     \
+    } while (0)
+
+// A string of len characters ending with its terminator on the last byte
+// before the guard page, shifted back by pad bytes
+static char* place(const size_t len, const size_t pad, const char fill) {
+    char* s = guarded_page + page_size - len - 1 - pad;
+    for (size_t i = 0; i < len; i++) s[i] = static_cast<char>(fill + i % 23);
+    s[len] = '\0';
+    return s;
+}
+
+static void check_scans() {
+    for (size_t len = 0; len < MAX_LEN; len++) {
+        for (size_t pad = 0; pad < 16; pad++) {
+            const char* s = place(len, pad, 'a');
+
+            CHECK(strlen(s) == libc_strlen(s), "strlen len %zu pad %zu", len, pad);
+            for (size_t max = 0; max <= len + 1; max++) {
+                CHECK(strnlen(s, max) == libc_strnlen(s, max), "strnlen len %zu pad %zu max %zu", len, pad, max);
+            }
+
+            // Every character present, the terminator and one that is absent
+            for (size_t i = 0; i <= len; i++) {
+                const int c = static_cast<unsigned char>(s[i]);
+                CHECK(strchr(s, c) == libc_strchr(s, c), "strchr len %zu pad %zu char %zu", len, pad, i);
+                CHECK(memchr(s, c, len + 1) == libc_memchr(s, c, len + 1), "memchr len %zu pad %zu char %zu", len, pad, i);
+                CHECK(memchr(s, c, i) == libc_memchr(s, c, i), "memchr len %zu pad %zu count %zu", len, pad, i);
+            }
+            CHECK(strchr(s, '#') == libc_strchr(s, '#'), "strchr len %zu pad %zu absent", len, pad);
+            CHECK(memchr(s, '#', len) == libc_memchr(s, '#', len), "memchr len %zu pad %zu absent", len, pad);
+        }
+    }
+}
+
+static void check_compares() {
+    char other[MAX_LEN + 16];
+    for (size_t len = 0; len < MAX_LEN; len++) {
+        for (size_t pad = 0; pad < 16; pad++) {
+            const char* s = place(len, pad, 'a');
+
+            // Same and different alignment, equal strings and every position
+            // of a difference, including against a shorter string
+            for (size_t shift = 0; shift < 8; shift++) {
+                char* t = other + shift;
+                for (size_t diff = 0; diff <= len + 1; diff++) {
+                    for (size_t i = 0; i <= len; i++) t[i] = s[i];
+                    if (diff < len) t[diff] = static_cast<char>(t[diff] + (diff % 2 ? 1 : -1));
+                    if (diff == len && len) t[len - 1] = '\0';
+
+                    CHECK(sign(strcmp(s, t)) == sign(libc_strcmp(s, t)), "strcmp len %zu pad %zu shift %zu diff %zu", len, pad, shift, diff);
+                    CHECK(sign(strcmp(t, s)) == sign(libc_strcmp(t, s)), "strcmp reversed len %zu pad %zu shift %zu diff %zu", len, pad, shift, diff);
+                    for (size_t n = 0; n <= len + 1; n += 3) {
+                        CHECK(sign(strncmp(s, t, n)) == sign(libc_strncmp(s, t, n)), "strncmp len %zu pad %zu shift %zu diff %zu n %zu", len, pad, shift, diff, n);
+                    }
+                }
+            }
+        }
+    }
+
+    // Bytes above 0x7F compare as unsigned
+    CHECK(strcmp("\x80", "a") > 0, "strcmp is not unsigned");
+}
+
+static bool equal(const char* a, const char* b, const size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (a[i] != b[i]) return false;
+    }
+    return true;
+}
+
+static void check_copies() {
+    char dst[2 * MAX_LEN + 32];
+    char expected[2 * MAX_LEN + 32];
+
+    for (size_t len = 0; len < MAX_LEN; len++) {
+        for (size_t pad = 0; pad < 8; pad++) {
+            const char* s = place(len, pad, 'A');
+            for (size_t shift = 0; shift < 8; shift++) {
+                char* d = dst + shift;
+
+                for (char& c : dst) c = '~';
+                CHECK(strcpy(d, s) == d && equal(d, s, len + 1) && d[len + 1] == '~', "strcpy len %zu pad %zu shift %zu", len, pad, shift);
+
+                for (const size_t n : {len / 2, len, len + 5}) {
+                    for (char& c : dst) c = '~';
+                    for (char& c : expected) c = '~';
+                    for (size_t i = 0; i < n; i++) expected[shift + i] = i < len ? s[i] : '\0';
+                    strncpy(d, s, n);
+                    CHECK(equal(dst, expected, sizeof(dst)), "strncpy len %zu pad %zu shift %zu n %zu", len, pad, shift, n);
+                }
+
+                for (char& c : dst) c = '~';
+                d[0] = 'x';
+                d[1] = 'y';
+                d[2] = '\0';
+                strcat(d, s);
+                CHECK(d[0] == 'x' && d[1] == 'y' && equal(d + 2, s, len + 1), "strcat len %zu pad %zu shift %zu", len, pad, shift);
+
+                for (const size_t n : {size_t{0}, len / 2, len, len + 5}) {
+                    d[0] = 'x';
+                    d[1] = '\0';
+                    strncat(d, s, n);
+                    const size_t copied = n < len ? n : len;
+                    CHECK(d[0] == 'x' && equal(d + 1, s, copied) && d[1 + copied] == '\0', "strncat len %zu pad %zu shift %zu n %zu", len, pad, shift, n);
+                }
+            }
+        }
+    }
+}
+
+// Keeps the results from being optimized away
+static volatile uint64_t result_sink;
+
+// The byte loop the kernel used before, as a baseline. GCC would otherwise
+// recognize it and call glibc's strlen instead.
+__attribute__((noinline, optimize("no-tree-loop-distribute-patterns"))) static size_t byte_strlen(const char* str) {
+    size_t len = 0;
+    while (str[len]) len++;
+    return len;
+}
+
+template <typename F>
+static double time_ns(const uint64_t iterations, F&& f) {
+    uint64_t acc = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < iterations; i++) {
+        acc += f();
+        __asm__ volatile("" ::: "memory"); // keep calls from being hoisted out of the loop
+    }
+    const auto end = std::chrono::steady_clock::now();
+    result_sink = acc;
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+static void bench(const uint64_t iterations) {
+    static const size_t lengths[] = {7, 32, 256, 4000};
+    for (const size_t len : lengths) {
+        const char* s = place(len, 3, 'a');
+
+        // An equal copy at the same word offset, so strcmp runs to the end
+        alignas(8) static char copy[4096 + 16];
+        char* t = copy + (reinterpret_cast<uintptr_t>(s) & 7);
+        for (size_t i = 0; i <= len; i++) t[i] = s[i];
+        const uint64_t n = iterations * 16 / (len + 16);
+
+        printf("len %4zu  strlen %6.1f/%6.1f (bytes %6.1f)  memchr %6.1f/%6.1f  strchr %6.1f/%6.1f  strcmp %6.1f/%6.1f ns (kernel/glibc)\n",
+               len,
+               time_ns(n, [&] { return strlen(s); }),
+               time_ns(n, [&] { return libc_strlen(s); }),
+               time_ns(n, [&] { return byte_strlen(s); }),
+               time_ns(n, [&] { return reinterpret_cast<uintptr_t>(memchr(s, '#', len)); }),
+               time_ns(n, [&] { return reinterpret_cast<uintptr_t>(libc_memchr(s, '#', len)); }),
+               time_ns(n, [&] { return reinterpret_cast<uintptr_t>(strchr(s, '#')); }),
+               time_ns(n, [&] { return reinterpret_cast<uintptr_t>(libc_strchr(s, '#')); }),
+               time_ns(n, [&] { return static_cast<uint64_t>(strcmp(s, t)); }),
+               time_ns(n, [&] { return static_cast<uint64_t>(libc_strcmp(s, t)); }));
+    }
+}
+
+int main(const int argc, char** argv) {
+    const uint64_t iterations = argc > 1 ? strtoull(argv[1], nullptr, 0) : 2000000;
+
+    page_size = sysconf(_SC_PAGESIZE);
+    guarded_page = static_cast<char*>(mmap(nullptr, 2 * page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (guarded_page == MAP_FAILED || mprotect(guarded_page + page_size, page_size, PROT_NONE) != 0) {
+        perror("mmap");
+        return 1;
+    }
+
+    check_scans();
+    check_compares();
+    check_copies();
+    printf("correctness: %s (%llu failures)\n", failures ? "FAILED" : "ok", static_cast<unsigned long long>(failures));
+    if (failures) return 1;
+
+    bench(iterations);
+    return 0;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+
+// Local APIC timer and performance counter overflow interrupts are
+// delivered as IRQs 16 and 17, after the ISA IRQs, and the HPET one-shot
+// comparator, routed to an I/O APIC input above them, as IRQ 18
+#define APIC_TIMER_IRQ      16
+#define APIC_PMU_IRQ        17
+#define APIC_HPET_IRQ       18
+#define APIC_SPURIOUS_VECTOR 0xFF
+
+/**
+ * Local APIC and I/O APIC driver. Once enabled the ISA IRQs are routed
+ * through the I/O APIC (honoring MADT source overrides) and the 8259 PIC is
+ * masked off.
+ */
+namespace apic {
+    /**
+     * Map and enable the local APIC, route the ISA IRQs that were unmasked on
+     * the PIC through the I/O APIC and disable the PIC
+     */
+    void init();
+
+    bool is_enabled();
+
+    void eoi();
+
+    void mask_irq(uint8_t irq);
+
+    void unmask_irq(uint8_t irq);
+
+    /**
+     * Route an I/O APIC input above the ISA IRQs to irq, edge triggered and
+     * active high
+     * @return false without an I/O APIC that has the input
+     */
+    bool route_gsi(uint32_t gsi, uint8_t irq);
+
+    /**
+     * Calibrate the local APIC timer against the TSC and set it up for one-shot
+     * deadlines, using TSC-deadline mode when the CPU supports it. The
+     * interrupt handler is left to the timer driver.
+     */
+    void apic_start_timer();
+
+    bool has_timer();
+
+    bool has_tsc_deadline();
+
+    /**
+     * Raise a timer interrupt at deadline_ns on the tsc::now_ns() clock,
+     * replacing any pending deadline. Deadlines in the past fire immediately.
+     */
+    void set_deadline(uint64_t deadline_ns);
+
+    /**
+     * Deliver performance counter overflows as IRQ APIC_PMU_IRQ, or mask them.
+     * Delivering one masks the entry again, so the handler re-enables it.
+     * @return false without a local APIC
+     */
+    bool set_pmu_interrupt(bool enable);
+}
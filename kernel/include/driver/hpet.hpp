@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * High Precision Event Timer, found through the ACPI HPET table. The main
+ * counter is used as a clocksource and one comparator as a one-shot event
+ * source routed through the I/O APIC, for deadlines on machines without a
+ * local APIC timer.
+ */
+namespace hpet {
+    typedef void (*oneshot_callback)();
+
+    /**
+     * Locate and map the HPET and start its main counter
+     * @return false if the machine has no usable HPET
+     */
+    bool init();
+
+    bool is_available();
+
+    /**
+     * Main counter frequency in Hz
+     */
+    uint64_t get_frequency();
+
+    uint64_t read_counter();
+
+    /**
+     * Nanoseconds since init()
+     */
+    uint64_t now_ns();
+
+    /**
+     * Route the one-shot comparator through the I/O APIC as IRQ APIC_HPET_IRQ.
+     * Needs apic::init() first.
+     * @param callback called from the interrupt handler when a one-shot fires,
+     * or from arm_oneshot() for one that is already due
+     * @return false if no comparator can be routed to an interrupt
+     */
+    bool start_oneshot(oneshot_callback callback);
+
+    /**
+     * Fire the one-shot comparator delay_ns from now, replacing any pending
+     * one. Delays are capped at 10 s, longer ones fire early.
+     * @return false before start_oneshot() succeeded
+     */
+    bool arm_oneshot(uint64_t delay_ns);
+
+    void disarm_oneshot();
+}
@@ -10,4 +10,5 @@ namespace limine_requests {
     extern volatile limine_memmap_request memmap_request;
     extern volatile limine_hhdm_request hhdm_request;
     extern volatile limine_rsdp_request rsdp_request;
+    extern volatile limine_module_request module_request;
 }
\ No newline at end of file
@@ -23,13 +23,54 @@
 #define ICW4_SFNM	    0x10	/* Special fully nested (not) */
 
 #define CASCADE_IRQ 2
+#define IRQ_COUNT   19  /* ISA IRQs 0-15 plus the local APIC timer, PMI and HPET */
+#define IRQ_VECTOR_BASE 32  /* IRQ n is delivered on vector IRQ_VECTOR_BASE + n */
+#define IRQ_VECTORS 256
 
+/**
+ * Handlers get the interrupted rip, rsp, rbp and caller-saved registers in r.
+ * rbx and r12-r15 are not saved on entry and their fields are left unset.
+ */
 typedef void (*irq_handler)(regs* r);
 
 void irq_install_handler(uint32_t irq, irq_handler handler);
 
 void irq_uninstall_handler(uint32_t irq);
 
+/**
+ * Handle a vector outside the IRQ range, such as a software interrupt. No EOI
+ * is sent for these.
+ * @param handler nullptr to uninstall
+ */
+void irq_install_vector(uint8_t vector, irq_handler handler);
+
+/**
+ * Acknowledge IRQs at the local APIC from now on instead of the PIC
+ */
+void irq_use_apic_eoi();
+
+/**
+ * @return true while an IRQ handler is running
+ */
+bool in_irq();
+
+/**
+ * @return registers of the code the running IRQ interrupted, nullptr outside
+ * of IRQ handlers
+ */
+regs* irq_regs();
+
+/**
+ * @return how many times the IRQ has fired since boot
+ */
+uint64_t irq_count(uint32_t irq);
+
+/**
+ * @return how many times the vector has been taken since boot, exceptions
+ * (vectors below IRQ_VECTOR_BASE) are not counted
+ */
+uint64_t vector_count(uint8_t vector);
+
 namespace pic {
     void init();
     void mask_irq(uint8_t irq);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+#define PM_TIMER_FREQUENCY 3579545
+
+/**
+ * ACPI power management timer described by the FADT, a fixed 3.579545 MHz
+ * counter that is 24 or 32 bits wide. Used as a clocksource when there is no
+ * HPET.
+ */
+namespace pm_timer {
+    bool init();
+
+    bool is_available();
+
+    /**
+     * Raw counter value, only the low 24 or 32 bits are valid
+     */
+    uint32_t read();
+
+    /**
+     * Mask of the valid counter bits
+     */
+    uint32_t get_mask();
+
+    /**
+     * Nanoseconds since init(). Wraps are tracked between calls, so this must
+     * be called at least once per counter period (about 4.7 s for 24 bits).
+     */
+    uint64_t now_ns();
+}
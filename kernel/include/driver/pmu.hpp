@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+
+#include "kernel/system.hpp"
+
+/**
+ * Architectural performance monitoring (CPUID leaf 0xA). init() programs one
+ * general-purpose counter for each event the CPU supports, counting in both
+ * rings from then on, and read() samples them all with rdpmc. A spare counter,
+ * when there is one, can raise an interrupt every so many events for sampling.
+ *
+ * Without a PMU (AMD, or QEMU under TCG) every event reads as zero and
+ * callers fall back to TSC timing.
+ */
+
+enum PmuEvent : uint8_t {
+    PMU_CYCLES,        // unhalted core cycles
+    PMU_INSTRUCTIONS,  // instructions retired
+    PMU_LLC_MISSES,    // last level cache misses
+    PMU_BRANCH_MISSES, // mispredicted branches retired
+    PMU_EVENT_COUNT
+};
+
+struct PmuCounts {
+    uint64_t values[PMU_EVENT_COUNT];
+};
+
+typedef void (*pmu_overflow_handler)(regs* r);
+
+namespace pmu {
+    /**
+     * Detect the PMU and start counting
+     * @return false if there is no usable PMU and only the TSC is available
+     */
+    bool init();
+
+    bool is_available();
+
+    bool has_event(PmuEvent event);
+
+    const char* event_name(PmuEvent event);
+
+    /**
+     * Read the running counts. Events the CPU does not count stay 0.
+     */
+    void read(PmuCounts& counts);
+
+    /**
+     * Call handler from the overflow interrupt every period occurrences of
+     * event, on a counter of its own
+     * @return false without a PMU, a spare counter or a local APIC
+     */
+    bool start_sampling(PmuEvent event, uint64_t period, pmu_overflow_handler handler);
+
+    void stop_sampling();
+}
@@ -24,42 +24,38 @@ enum Key {
     KEY_W = 0x1D,
     KEY_X = 0x22,
     KEY_Z = 0x1A,
+
+    KEY_F1 = 0x05,
+    KEY_F2 = 0x06,
+    KEY_F3 = 0x04,
+    KEY_F4 = 0x0C,
+    KEY_F12 = 0x07,
 };
 
 struct KeyEvent {
     uint8_t scancode;
     bool break_key;
     bool extended_key;
+    uint64_t timestamp; // tsc::now_ns() when the first byte arrived, 0 for replayed keys
 };
 
-using key_listener_t = void(*)(KeyEvent ev);
-
 namespace Keyboard {
-    void register_listener(key_listener_t listener);
-
-    void unregister_listener();
-
-    /**
-     * Process any queued scancodes, forwarding them to the listener
-     */
-    void process_queue();
-
     /**
      * Register interrupt on channel 1 for handling keypresses
      */
     void init();
 }
 
-void kb_register_listener(key_listener_t listener);
-
-void kb_unregister_listener();
-
 /**
- * Process any queued scancodes, forwarding them to the listener
+ * Register interrupt on channel 1 for handling keypresses. Each decoded key
+ * is posted to the event queue as an EVENT_KEY, except make codes for keys
+ * that are already down, so typematic repeats never reach the queue. The
+ * typematic rate is also set as slow as it goes, as held keys are repeated
+ * by the game instead.
  */
-void kb_process_queue();
+void kb_init();
 
 /**
- * Register interrupt on channel 1 for handling keypresses
+ * @return true if the key is currently held down
  */
-void kb_init();
+bool kb_is_pressed(uint8_t scancode, bool extended);
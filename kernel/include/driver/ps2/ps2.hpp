@@ -1,9 +1,27 @@
 #pragma once
 
+#include <cstdint>
+
 #define PS2_DATA_PORT    0x60
 #define PS2_COMMAND_PORT 0x64
 #define PS2_STATUS_PORT  0x64
 
+#define PS2_ACK          0xFA
+
+// Status polls before giving up on the controller, each port read takes about
+// a microsecond so this is on the order of 100 ms
+#define PS2_TIMEOUT_SPINS 100000
+
 namespace ps2 {
-    void init();
+    /**
+     * Set up the controller and enable scanning on the first port
+     * @return false if there is no controller or it stopped responding
+     */
+    bool init();
+
+    /**
+     * Send a byte to the device on the first port and wait for its ACK
+     * @return false if the device answered with anything else or timed out
+     */
+    bool send(uint8_t byte);
 }
\ No newline at end of file
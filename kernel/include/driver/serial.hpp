@@ -1,6 +1,12 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+
 #define PORT 0x3F8 // COM1
+#define SERIAL_IRQ 4
+#define SERIAL_TX_BUFFER_SIZE 4096
+#define SERIAL_HEX_LINE_BYTES 32
 
 namespace serial {
     /**
@@ -9,16 +15,51 @@ namespace serial {
      */
     int init();
 
+    /**
+     * Switch to interrupt driven I/O. Received bytes are posted to the event
+     * queue as EVENT_SERIAL and are no longer available through read().
+     * Writes are queued in a SERIAL_TX_BUFFER_SIZE ring that the transmitter
+     * interrupt drains a FIFO at a time, only blocking the writer when the
+     * ring is full.
+     */
+    void enable_irq();
+
+    /**
+     * Write out everything still queued and go back to synchronous writes,
+     * for when interrupts can no longer be relied on, such as in panic()
+     */
+    void sync();
+
+    /**
+     * Change the baud rate, after sending any queued output at the old one
+     * @return false if the rate is not 115200 divided by a whole number
+     */
+    bool set_baud(uint32_t baud);
+
     bool received();
 
     char read();
 
     bool transmitted();
 
+    /**
+     * @return bytes that can be written without blocking, SERIAL_TX_BUFFER_SIZE
+     * while writes are synchronous
+     */
+    size_t tx_space();
+
+    void write(const char* data, size_t len);
+
     void putchar(char c);
 
     void print(const char* str);
 
+    /**
+     * Write data as lines of SERIAL_HEX_LINE_BYTES bytes in lower-case hex,
+     * the format of the replay, profile and trace dumps
+     */
+    void write_hex(const void* data, size_t len);
+
     __attribute__ ((format (printf, 1, 2)))
     void printf(const char* fmt, ...);
 
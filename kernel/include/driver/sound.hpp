@@ -6,6 +6,7 @@ static void snd_play(uint32_t frequency);
 
 static void snd_stop();
 
+/**
+ * Play a short beep, stopped from a timer
+ */
 void beep();
-
-void snd_tick();
@@ -13,9 +13,37 @@ namespace timer {
 
     void wait(uint32_t ticks);
 
+    /**
+     * Wait for ms milliseconds, rounded up to whole ticks rather than truncated
+     */
     void wait_ms(uint32_t ms);
 
-    inline uint64_t get_ticks() { return timer_ticks; }
+    /**
+     * Ticks since boot, derived from the TSC once the periodic tick is stopped
+     */
+    uint64_t get_ticks();
+
+    /**
+     * Halt until the next interrupt, arming the APIC timer so that one arrives
+     * by deadline_ns on the tsc::now_ns() clock, or earlier for a timer on the
+     * timer wheel. Without the APIC timer the
+     * next PIT tick wakes the CPU instead. Returns immediately if the deadline
+     * has passed, and early on any other interrupt. May be called with
+     * interrupts disabled and always returns with them enabled.
+     */
+    void sleep_until(uint64_t deadline_ns);
+
+    /**
+     * Mask the periodic PIT interrupt so the CPU only wakes for deadlines,
+     * wheel timers and input. Requires the APIC timer or, without one, an HPET
+     * comparator that can be routed through the I/O APIC, and a calibrated TSC.
+     */
+    void stop_tick();
+
+    /**
+     * Tick rate in Hz
+     */
+    uint32_t get_frequency();
 
     inline void wait_for_tick(uint64_t previous) {
         // Wait for an interrupt-driven tick, but bound the number of HLT
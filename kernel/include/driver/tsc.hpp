@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Monotonic high resolution clock based on the time stamp counter, calibrated
+ * at boot against the HPET, the ACPI PM timer or PIT channel 2, whichever is
+ * available first. Until init() succeeds the clock falls back to
+ * the PIT tick count.
+ */
+namespace tsc {
+    /**
+     * Detect the TSC and measure its frequency
+     * @return false if the TSC could not be calibrated
+     */
+    bool init();
+
+    /**
+     * Whether the TSC runs at a constant rate regardless of P-states and halts
+     */
+    bool is_invariant();
+
+    /**
+     * Measured TSC frequency in Hz, or 0 if not calibrated
+     */
+    uint64_t get_frequency();
+
+    uint64_t now_cycles();
+
+    /**
+     * Nanoseconds since init()
+     */
+    uint64_t now_ns();
+
+    uint64_t cycles_to_ns(uint64_t cycles);
+
+    uint64_t ns_to_cycles(uint64_t ns);
+}
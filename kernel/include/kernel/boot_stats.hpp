@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Boot phase timing. kmain marks the end of each initialization step with a
+ * raw TSC reading, which works before the TSC is calibrated, and report()
+ * logs how long each step took once the first frame is on screen.
+ */
+
+#define BOOT_STATS_MAX_PHASES 32
+
+namespace boot_stats {
+    /**
+     * Note the TSC at kmain entry, everything is measured from here
+     */
+    void start();
+
+    /**
+     * Close the step that started at the previous mark. Ignored after report().
+     * @param name a string literal, kept by pointer
+     */
+    void mark(const char* name);
+
+    /**
+     * Log each step and the time from kmain to now, once
+     */
+    void report();
+}
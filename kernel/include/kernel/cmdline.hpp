@@ -1,8 +1,47 @@
 #pragma once
+
+#include <cstdint>
+
 #include "lib/log.hpp"
+#include "tetris/input.hpp"
+
+enum ReplayMode {
+    REPLAY_OFF,
+    REPLAY_REALTIME, // play the replay module back at normal speed
+    REPLAY_FAST      // play the replay module back without rendering
+};
 
 struct Config {
     LogLevel log_level;
+    ReplayMode replay_mode;
+    bool autoplay;
+    uint8_t perft_depth; // run the move-generation benchmark to this depth at boot, 0 to skip
+    uint32_t grid_boards; // run the many-board stress mode with up to this many boards, 0 to play normally
+    RepeatConfig repeat;  // held key timings, set in ms with das= and arr=
+    uint32_t baud;        // serial baud rate, 0 to keep the default
+    uint32_t profile_hz;  // sampling profiler rate, 0 to leave it off
+    bool profile_stacks;  // walk frame pointers for each profiler sample
+    uint32_t profile_cycles; // sample every this many core cycles with the PMU, 0 to use prof=
+    const char* trace;    // tracepoint to enable at boot, "" for all of them
+    uint32_t irq_bench;   // software interrupts to time at boot, 0 to skip
+};
+
+inline Config config = {
+    LOG_LEVEL_DEBUG,
+    REPLAY_OFF,
+    false,
+    0,
+    0,
+    {DEFAULT_DAS_TICKS, DEFAULT_ARR_TICKS, DEFAULT_SOFT_DROP_TICKS},
+    0,
+    0,
+    false,
+    0,
+    nullptr,
+    0
 };
 
-void parse_cmdline(char* cmdline);
\ No newline at end of file
+/**
+ * Parse space separated key=value options into config. The string is modified in place.
+ */
+void parse_cmdline(char* cmdline);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+#include "driver/ps2/keyboard.hpp"
+
+struct Timer;
+
+/**
+ * Queue of events posted from interrupt handlers and drained by the main loop,
+ * which halts in events::wait() while there is nothing to do.
+ */
+
+#define EVENT_QUEUE_SIZE    256
+#define EVENT_WAIT_FOREVER  UINT64_MAX
+
+struct SerialByte {
+    char value;
+    uint64_t timestamp; // tsc::now_ns() when the byte was received
+};
+
+enum EventType : uint8_t {
+    EVENT_KEY,      // key press or release from the PS/2 keyboard
+    EVENT_TIMER,    // a deferred timer fired
+    EVENT_SERIAL    // byte received on the serial port
+};
+
+struct Event {
+    EventType type;
+    union {
+        KeyEvent key;
+        Timer* timer;
+        SerialByte serial;
+    };
+};
+
+namespace events {
+    /**
+     * Queue an event. Called from interrupt handlers.
+     * @return false if the queue is full and the event was dropped
+     */
+    bool post(const Event& ev);
+
+    /**
+     * Take the oldest queued event
+     * @return false if the queue is empty
+     */
+    bool poll(Event& out);
+
+    /**
+     * Halt until an event is queued or deadline_ns passes on the tsc::now_ns()
+     * clock. Returns immediately if an event is already queued.
+     */
+    void wait(uint64_t deadline_ns);
+
+    /**
+     * Number of events dropped because the queue was full
+     */
+    uint64_t get_dropped();
+}
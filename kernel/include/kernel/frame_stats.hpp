@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "driver/pic.hpp"
+#include "driver/pmu.hpp"
+
+/**
+ * Per-frame timing for the on-screen HUD. The main loop and the renderer mark
+ * which phase they are entering, and the TSC cycles between marks are
+ * charged to the phase being left. A frame ends when it has been flushed to
+ * the screen, so idle time between frames counts towards the next one.
+ * When the CPU has a PMU, its counters are charged to phases the same way.
+ *
+ * Frame times are kept for the last FRAME_STATS_WINDOW frames. FPS, phase
+ * averages and IRQ rates are totalled over a second and published together.
+ */
+
+#define FRAME_STATS_WINDOW 64 // frames, a power of two
+
+enum FramePhase : uint8_t {
+    PHASE_INPUT, // dispatching events and flushing the log
+    PHASE_SIM,   // advancing the game
+    PHASE_CLEAR, // clearing the back buffer
+    PHASE_DRAW,  // drawing into the back buffer
+    PHASE_FLUSH, // copying the back buffer to the framebuffer
+    PHASE_IDLE,  // waiting for the next event or frame
+    PHASE_COUNT
+};
+
+struct FrameStats {
+    // Over the last FRAME_STATS_WINDOW frames
+    uint32_t frame_min_us;
+    uint32_t frame_avg_us;
+    uint32_t frame_max_us;
+    uint32_t frame_us[FRAME_STATS_WINDOW]; // oldest first
+    uint32_t frames;                       // valid entries in frame_us
+
+    // Over the last full second
+    uint32_t fps;
+    uint32_t phase_us[PHASE_COUNT]; // average per frame
+    uint64_t phase_events[PHASE_COUNT][PMU_EVENT_COUNT]; // average per frame, 0 without a PMU
+    uint32_t irqs[IRQ_COUNT];       // per second, by IRQ line
+
+    size_t heap_used;
+};
+
+namespace frame_stats {
+    /**
+     * Charge the cycles since the last call to the previous phase and start
+     * timing phase
+     */
+    void enter(FramePhase phase);
+
+    /**
+     * Mark a frame as on screen
+     */
+    void frame_presented();
+
+    void get(FrameStats& stats);
+
+    const char* phase_name(FramePhase phase);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Interrupt latency self-test. Raises software interrupts with `int` and
+ * times in TSC cycles how long it takes from just before the instruction to
+ * the handler running, and to being back after the iretq. Every sample goes
+ * once through the normal entry stub and once through a copy of the old one
+ * that saves all fifteen registers, so the log shows what the lean path saves.
+ */
+
+#define IRQ_BENCH_VECTOR             0xF0
+#define IRQ_BENCH_FULL_VECTOR        0xF1 // must match irq.asm
+#define IRQ_BENCH_DEFAULT_ITERATIONS 10000
+
+namespace irq_bench {
+    /**
+     * Run the benchmark with interrupts off and log the results
+     */
+    void run(uint32_t iterations);
+}
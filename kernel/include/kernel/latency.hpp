@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Input-to-photon latency: the time from a key's first scancode byte arriving
+ * to the end of the screen::flush() that first shows its effect. Samples go
+ * into a log-linear histogram in microseconds, accurate to about 6%.
+ */
+
+#define LATENCY_REPORT_SAMPLES 64
+
+struct LatencyStats {
+    uint32_t count;
+    uint64_t p50_us;
+    uint64_t p99_us;
+    uint64_t max_us;
+};
+
+namespace latency {
+    /**
+     * Note an input that changed the game, to be measured at the next frame
+     * @param timestamp_ns tsc::now_ns() when the input arrived, 0 is ignored
+     */
+    void input(uint64_t timestamp_ns);
+
+    /**
+     * Record every input noted since the last frame. Called once the frame is
+     * on screen. Logs a summary every LATENCY_REPORT_SAMPLES samples.
+     */
+    void frame_presented();
+
+    LatencyStats get_stats();
+
+    /**
+     * Log the current percentiles to serial
+     */
+    void report();
+}
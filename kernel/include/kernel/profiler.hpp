@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+#include "driver/pmu.hpp"
+
+/**
+ * Sampling profiler. A periodic timer on the timer wheel records where the
+ * timer interrupt landed, and optionally the return addresses found by
+ * walking frame pointers, into a preallocated buffer. The sampling rate is
+ * independent of the game tick, but limited to 1 kHz by the wheel's
+ * millisecond resolution. With a PMU, samples can instead be taken every so
+ * many hardware events, from the counter overflow interrupt. dump() writes the samples to serial for
+ * scripts/profile.py to turn into folded stacks for flamegraph.pl.
+ */
+
+#define PROFILE_MAX_RATE     1000
+#define PROFILE_MAX_DEPTH    32
+#define PROFILE_BUFFER_WORDS (128 * 1024) // 1 MiB, about 60000 samples of rip only
+#define PROFILE_DUMP_CHAR    'f'          // serial command that dumps the profile
+
+namespace profiler {
+    /**
+     * Start sampling rate_hz times a second, walking the stack of each sample
+     * if stacks is set. Restarting keeps the samples taken so far.
+     */
+    void start(uint32_t rate_hz, bool stacks);
+
+    /**
+     * Start sampling every period occurrences of event
+     * @return false if the PMU cannot sample the event, nothing is started
+     */
+    bool start_events(PmuEvent event, uint64_t period, bool stacks);
+
+    void stop();
+
+    bool is_running();
+
+    /**
+     * Write every sample taken so far to serial, hex-encoded between
+     * "profile:" lines, and clear the buffer. Sampling pauses meanwhile.
+     */
+    void dump();
+}
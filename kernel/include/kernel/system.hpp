@@ -22,4 +22,25 @@ uint32_t inl(uint16_t port);
 
 void outl(uint16_t port, uint32_t data);
 
+uint64_t rdtsc();
+
+/**
+ * Disable interrupts, returning the previous RFLAGS for irq_restore()
+ */
+inline uint64_t irq_save() {
+    uint64_t flags;
+    asm volatile("pushfq; pop %0; cli" : "=r" (flags) : : "memory");
+    return flags;
+}
+
+inline void irq_restore(const uint64_t flags) {
+    if (flags & (1 << 9)) asm volatile("sti" : : : "memory");
+}
+
+uint64_t rdmsr(uint32_t msr);
+
+void wrmsr(uint32_t msr, uint64_t value);
+
+void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t& eax, uint32_t& ebx, uint32_t& ecx, uint32_t& edx);
+
 [[noreturn]] void panic(const char* msg, ...);
\ No newline at end of file
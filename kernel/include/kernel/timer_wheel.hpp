@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Hierarchical timer wheel with millisecond resolution. Timers are intrusive
+ * and owned by the caller, so adding and cancelling are O(1) and never
+ * allocate. The wheel is advanced from the timer interrupt and callbacks run
+ * there, except for timers marked deferred, which are posted to the event
+ * queue as an EVENT_TIMER for the main loop to dispatch.
+ */
+
+#define TIMER_WHEEL_NONE UINT64_MAX
+
+typedef void (*timer_callback)(void* data);
+
+struct Timer {
+    Timer* next = nullptr;
+    Timer* prev = nullptr;
+    uint64_t expires = 0;  // ms on the tsc::now_ns() clock
+    uint32_t period = 0;   // ms between runs, 0 for one-shot timers
+    timer_callback callback = nullptr;
+    void* data = nullptr;
+    bool deferred = false; // run from the main loop instead of the interrupt
+    bool pending = false;
+    bool deferred_queued = false;
+    uint8_t level = 0;     // wheel slot the timer is linked into
+    uint8_t slot = 0;
+};
+
+namespace timer_wheel {
+    /**
+     * Set the callback of a timer. Deferred timers run from dispatch().
+     */
+    void setup(Timer& timer, timer_callback callback, void* data, bool deferred);
+
+    /**
+     * Start a timer delay_ms from now, rescheduling it if it is already pending.
+     * A non-zero period makes it repeat. The expiry may be pushed back by up
+     * to slack_ms so that timers due around the same time fire together.
+     */
+    void add(Timer& timer, uint32_t delay_ms, uint32_t period_ms = 0, uint32_t slack_ms = 0);
+
+    /**
+     * Stop a timer, including a deferred run already posted to the event queue
+     * @return false if the timer was neither pending nor queued
+     */
+    bool cancel(Timer& timer);
+
+    /**
+     * Run every timer due by now_ms. Called from the timer interrupt.
+     */
+    void advance(uint64_t now_ms);
+
+    /**
+     * Run the callback of a deferred timer taken from an EVENT_TIMER, unless
+     * it was cancelled since
+     */
+    void dispatch(Timer& timer);
+
+    /**
+     * Earliest time in ms at which a timer may be due, or TIMER_WHEEL_NONE.
+     * Timers on the outer wheels report the start of their slot, so this can
+     * be early but never late.
+     */
+    uint64_t next_expiry();
+
+    uint32_t get_pending_count();
+}
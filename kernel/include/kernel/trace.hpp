@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Static tracepoints. TRACE_BEGIN/TRACE_END mark spans and TRACE_COUNTER
+ * samples a value. Each one writes a 16-byte record stamped with the raw TSC
+ * into a per-CPU ring without any formatting. The rings keep the most recent
+ * TRACE_RING_SIZE records, overwriting the oldest. The name of each
+ * tracepoint is stored once, in the trace_points section, and records refer
+ * to it by index.
+ *
+ * A tracepoint starts out as a 5-byte NOP with no flag to test, so it costs
+ * nothing measurable even in the innermost loops. Every NOP is listed in the
+ * __tracepoints table along with its out-of-line recording code, and
+ * enabling the tracepoint rewrites the NOP into a jump there.
+ *
+ * dump() streams the rings to serial a chunk at a time from the main loop, so
+ * the game keeps running while it drains, and scripts/trace2json.py converts
+ * them into Chrome trace JSON for Perfetto. Configuring with -DTETROS_TRACE=OFF
+ * compiles every tracepoint out, arguments included.
+ */
+#define TRACE_RING_SIZE  16384 // records per CPU, a power of two
+#define TRACE_MAX_CPUS   1     // the kernel only runs on the BSP so far
+#define TRACE_DUMP_CHAR  't'   // serial command that dumps the trace
+#define TRACE_NO_POINT   0xFFFF
+#define TRACE_NOP5       ".byte 0x0f, 0x1f, 0x44, 0x00, 0x00" // nopl 0(%rax,%rax), the size of a jmp rel32
+
+enum TraceType : uint8_t {
+    TRACE_TYPE_BEGIN,
+    TRACE_TYPE_END,
+    TRACE_TYPE_COUNTER
+};
+
+struct TracePoint {
+    const char* name;
+};
+
+struct TraceRecord {
+    uint64_t tsc;
+    uint16_t point; // index into the trace_points section
+    TraceType type;
+    uint8_t cpu;
+    uint32_t value; // counter value, or an argument of a span
+};
+
+static_assert(sizeof(TraceRecord) == 16, "trace records must stay 16 bytes");
+
+// An entry of the __tracepoints table, one for every site a tracepoint is used
+struct TraceJump {
+    uint64_t code;   // the NOP
+    uint64_t target; // where it jumps when enabled
+    const TracePoint* point;
+};
+
+namespace trace {
+    void record(const TracePoint* point, TraceType type, uint32_t value);
+
+    /**
+     * Patch every tracepoint in or out
+     */
+    void set_enabled(bool enable);
+
+    /**
+     * Patch the tracepoints called name in or out, returning how many sites were
+     * changed
+     */
+    uint32_t set_enabled(const char* name, bool enable);
+
+    /**
+     * Start writing the rings to serial, hex-encoded between "trace:" lines,
+     * and clearing them. Only the headers are written here, pump() writes the
+     * records. Recording pauses until the dump is finished.
+     */
+    void dump();
+
+    /**
+     * Write the next TRACE_DUMP_CHUNK records of a dump in progress, if the
+     * serial transmit ring has room for them. Called from the main loop, which
+     * the transmit interrupt wakes as the ring drains.
+     * @return true while the dump is unfinished
+     */
+    bool pump();
+}
+
+#ifdef TETROS_TRACE
+
+// True when the NOP at this site has been patched into a jump. The branch
+// itself is the only code emitted inline.
+#define TRACE_BRANCH_(point)                                                               \
+    ({                                                                                     \
+        __label__ trace_on_, trace_done_;                                                  \
+        bool trace_taken_ = false;                                                         \
+        asm goto("1: " TRACE_NOP5 "\n\t"                                                    \
+                 ".pushsection __tracepoints, \"a\"\n\t"                                    \
+                 ".balign 8\n\t"                                                           \
+                 ".quad 1b, %l[trace_on_], %c0\n\t"                                         \
+                 ".popsection"                                                             \
+                 : : "i"(&(point)) : : trace_on_);                                         \
+        goto trace_done_;                                                                  \
+    trace_on_:                                                                             \
+        trace_taken_ = true;                                                               \
+    trace_done_:                                                                           \
+        trace_taken_;                                                                      \
+    })
+
+// Define the tracepoint in the trace_points section and record an event on it
+#define TRACE_EVENT_(name, type, value)                                                    \
+    do {                                                                                   \
+        __attribute__((section("trace_points"), used)) static const TracePoint point_ = {name}; \
+        if (__builtin_expect(TRACE_BRANCH_(point_), 0)) trace::record(&point_, type, value); \
+    } while (0)
+
+#define TRACE_BEGIN(name)            TRACE_EVENT_(name, TRACE_TYPE_BEGIN, 0)
+#define TRACE_BEGIN_ARG(name, value) TRACE_EVENT_(name, TRACE_TYPE_BEGIN, value)
+#define TRACE_END(name)              TRACE_EVENT_(name, TRACE_TYPE_END, 0)
+#define TRACE_COUNTER(name, value)   TRACE_EVENT_(name, TRACE_TYPE_COUNTER, value)
+
+#else
+
+#define TRACE_BEGIN(name)            do {} while (0)
+#define TRACE_BEGIN_ARG(name, value) do {} while (0)
+#define TRACE_END(name)              do {} while (0)
+#define TRACE_COUNTER(name, value)   do {} while (0)
+
+#endif
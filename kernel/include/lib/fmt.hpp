@@ -0,0 +1,261 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "lib/format.hpp"
+
+/**
+ * Type-safe formatting with printf-style format strings parsed at compile
+ * time. The format string is wrapped in FMT() and turned into a fixed list of
+ * literal and argument ops, and each argument is printed according to its
+ * static type: the conversion only picks the presentation (d/i/u decimal,
+ * x/X hex, c character, s string, p pointer), so length modifiers are
+ * accepted and ignored and %d with a uint64_t prints the whole value.
+ * Conversions that do not fit their argument, unsupported flags and argument
+ * count mismatches fail to compile.
+ *
+ *   char text[32];
+ *   fmt::format_to(text, sizeof(text), FMT("SCORE: %d"), engine.get_score());
+ */
+
+#define FMT(str) ([] {                                              \
+        struct Str : fmt::FormatString {                             \
+            static constexpr const char* value() { return str; }     \
+        };                                                           \
+        return Str{};                                                \
+    }())
+
+namespace fmt {
+    /**
+     * Base of the types made by FMT()
+     */
+    struct FormatString {};
+
+    template <typename Str>
+    using if_format = std::enable_if_t<std::is_base_of_v<FormatString, Str>>;
+
+    namespace detail {
+        struct Spec {
+            char conv;      // d, u, x, X, c, s or p
+            bool left;      // '-', pad on the right
+            bool zero;      // '0', pad numbers with zeros
+            uint16_t width;
+        };
+
+        struct Op {
+            bool arg;
+            Spec spec;
+            uint16_t index; // argument printed by an arg op
+            uint16_t start; // text copied by a literal op
+            uint16_t len;
+        };
+
+        template <size_t N>
+        struct Program {
+            Op ops[N];
+            size_t count;
+            size_t args;
+            bool invalid;
+        };
+
+        /**
+         * Upper bound on the ops of a format string: every conversion can end
+         * a literal and add an argument, plus the trailing literal
+         */
+        constexpr size_t max_ops(const char* s) {
+            size_t n = 1;
+            for (; *s; s++) {
+                if (*s == '%') n += 2;
+            }
+            return n;
+        }
+
+        constexpr bool is_length_modifier(const char c) {
+            return c == 'h' || c == 'l' || c == 'z' || c == 'j' || c == 't';
+        }
+
+        template <size_t N>
+        constexpr Program<N> parse(const char* s) {
+            Program<N> p = {};
+            size_t i = 0, start = 0;
+
+            while (s[i]) {
+                if (s[i] != '%') {
+                    i++;
+                    continue;
+                }
+
+                if (i > start) {
+                    p.ops[p.count++] = {false, {}, 0, static_cast<uint16_t>(start), static_cast<uint16_t>(i - start)};
+                }
+                i++;
+
+                // "%%" starts the next literal at the second '%'
+                if (s[i] == '%') {
+                    start = i++;
+                    continue;
+                }
+
+                Spec spec = {};
+                if (s[i] == '-') {
+                    spec.left = true;
+                    i++;
+                }
+                while (s[i] == '0') {
+                    spec.zero = true;
+                    i++;
+                }
+                for (; s[i] >= '0' && s[i] <= '9'; i++) spec.width = spec.width * 10 + (s[i] - '0');
+                while (is_length_modifier(s[i])) i++;
+
+                switch (s[i]) {
+                    case 'd':
+                    case 'i':
+                        spec.conv = 'd';
+                        break;
+                    case 'u':
+                    case 'x':
+                    case 'X':
+                    case 'c':
+                    case 's':
+                    case 'p':
+                        spec.conv = s[i];
+                        break;
+                    default:
+                        p.invalid = true;
+                        return p;
+                }
+
+                p.ops[p.count++] = {true, spec, static_cast<uint16_t>(p.args++), 0, 0};
+                start = ++i;
+            }
+
+            if (i > start) {
+                p.ops[p.count++] = {false, {}, 0, static_cast<uint16_t>(start), static_cast<uint16_t>(i - start)};
+            }
+            return p;
+        }
+
+        template <typename Str>
+        inline constexpr Program<max_ops(Str::value())> program = parse<max_ops(Str::value())>(Str::value());
+
+        struct Writer {
+            char* pos;
+            char* end; // only used without a sink
+            const FormatSink* sink;
+            size_t count; // characters produced, including any truncated
+
+            void put(const char* data, size_t len) {
+                count += len;
+                if (sink) {
+                    sink->write(sink->ctx, data, len);
+                    return;
+                }
+                if (len > static_cast<size_t>(end - pos)) len = end - pos;
+                __builtin_memcpy(pos, data, len);
+                pos += len;
+            }
+        };
+
+        void write_integer(Writer& w, Spec spec, uint64_t magnitude, bool negative);
+        void write_string(Writer& w, Spec spec, const char* str);
+        void write_char(Writer& w, Spec spec, char c);
+
+        template <typename T>
+        constexpr bool accepts(const char conv) {
+            using D = std::decay_t<T>;
+            switch (conv) {
+                case 's': return std::is_convertible_v<const T&, const char*>;
+                case 'p': return std::is_pointer_v<D>;
+                case 'c': return std::is_integral_v<D>;
+                default: return std::is_integral_v<D> || std::is_enum_v<D>;
+            }
+        }
+
+        template <typename T>
+        inline void write_arg(Writer& w, const Spec spec, const T& value) {
+            using D = std::decay_t<T>;
+
+            if constexpr (std::is_convertible_v<const T&, const char*>) {
+                if (spec.conv == 's') return write_string(w, spec, value);
+            }
+
+            if constexpr (std::is_pointer_v<D>) {
+                write_integer(w, spec, reinterpret_cast<uintptr_t>(value), false);
+            } else if constexpr (std::is_same_v<D, bool>) {
+                write_integer(w, spec, value, false);
+            } else if constexpr (std::is_integral_v<D> || std::is_enum_v<D>) {
+                using I = typename std::conditional_t<std::is_enum_v<D>, std::underlying_type<D>, std::common_type<D>>::type;
+                if (spec.conv == 'c') return write_char(w, spec, static_cast<char>(value));
+
+                // Hex and %u print negative values as their two's complement,
+                // at the width of the argument type like printf
+                const I v = static_cast<I>(value);
+                if constexpr (std::is_signed_v<I>) {
+                    if (spec.conv == 'd' && v < 0) return write_integer(w, spec, 0 - static_cast<uint64_t>(v), true);
+                }
+                write_integer(w, spec, static_cast<std::make_unsigned_t<I>>(v), false);
+            }
+        }
+
+        template <size_t I, typename T, typename... Rest>
+        struct nth_type {
+            using type = typename nth_type<I - 1, Rest...>::type;
+        };
+
+        template <typename T, typename... Rest>
+        struct nth_type<0, T, Rest...> {
+            using type = T;
+        };
+
+        template <size_t I, typename T, typename... Rest>
+        constexpr const auto& nth(const T& first, const Rest&... rest) {
+            if constexpr (I == 0) return first;
+            else return nth<I - 1>(rest...);
+        }
+
+        template <typename Str, size_t I = 0, typename... Args>
+        inline void run(Writer& w, const Args&... args) {
+            constexpr auto& p = program<Str>;
+            static_assert(!p.invalid, "fmt: unsupported conversion in format string");
+            static_assert(p.invalid || p.args == sizeof...(Args), "fmt: argument count does not match the format string");
+
+            if constexpr (!p.invalid && p.args == sizeof...(Args) && I < p.count) {
+                constexpr Op op = p.ops[I];
+                if constexpr (op.arg) {
+                    using T = typename nth_type<op.index, Args...>::type;
+                    static_assert(accepts<T>(op.spec.conv), "fmt: conversion does not match the argument type");
+                    write_arg(w, op.spec, nth<op.index>(args...));
+                } else {
+                    w.put(Str::value() + op.start, op.len);
+                }
+                run<Str, I + 1>(w, args...);
+            }
+        }
+    }
+
+    /**
+     * Format into buf, truncating to cap - 1 characters and always terminating
+     * @return length of the untruncated output
+     */
+    template <typename Str, typename... Args, typename = if_format<Str>>
+    size_t format_to(char* buf, const size_t cap, Str, const Args&... args) {
+        detail::Writer w = {buf, buf + (cap ? cap - 1 : 0), nullptr, 0};
+        detail::run<Str>(w, args...);
+        if (cap) *w.pos = '\0';
+        return w.count;
+    }
+
+    /**
+     * Stream formatted output into a sink without buffering it
+     * @return number of characters written
+     */
+    template <typename Str, typename... Args, typename = if_format<Str>>
+    size_t format_to(const FormatSink& sink, Str, const Args&... args) {
+        detail::Writer w = {nullptr, nullptr, &sink, 0};
+        detail::run<Str>(w, args...);
+        return w.count;
+    }
+}
@@ -1,10 +1,103 @@
 #pragma once
 
 #include <cstdarg>
+#include <cstddef>
 
+/**
+ * Destination that formatted output is streamed into in chunks, so it never
+ * has to be held in one buffer. write may be called many times per format.
+ */
+struct FormatSink {
+    void (*write)(void* ctx, const char* data, size_t len);
+    void* ctx;
+};
+
+/**
+ * Format into a string allocated on the heap. Since the heap never frees,
+ * keep this to cold paths and prefer format_to or StackString elsewhere.
+ */
 char* vformat(const char* format, va_list ap);
 int vformat(char** out, const char* format, va_list ap);
+
+/**
+ * Format into buf, truncating to cap - 1 characters and always terminating
+ * @return length of the untruncated output, like vsnprintf
+ */
+int vformat_to(char* buf, size_t cap, const char* format, va_list ap);
+
+__attribute__ ((format (printf, 3, 4)))
+int format_to(char* buf, size_t cap, const char* format, ...);
+
+/**
+ * Stream formatted output into a sink without buffering it
+ * @return number of characters written
+ */
+int vformat_to(const FormatSink& sink, const char* format, va_list ap);
+
+__attribute__ ((format (printf, 2, 3)))
+int format_to(const FormatSink& sink, const char* format, ...);
 int simple_vsprintf(char** out, const char* format, va_list ap);
 
 __attribute__ ((format (printf, 1, 2)))
-char* format(const char* fmt, ...);
\ No newline at end of file
+char* format(const char* fmt, ...);
+
+/**
+ * Fixed-capacity string formatted in place, for short-lived text such as HUD
+ * labels. Output that does not fit is truncated and flagged.
+ */
+template <size_t N>
+class StackString {
+    static_assert(N > 0, "stack string needs room for the terminator");
+
+public:
+    StackString() = default;
+
+    __attribute__ ((format (printf, 2, 3)))
+    explicit StackString(const char* fmt, ...) {
+        va_list ap;
+        va_start(ap, fmt);
+        set_length(vformat_to(buf, N, fmt, ap));
+        va_end(ap);
+    }
+
+    /**
+     * Format onto the end of the string
+     */
+    __attribute__ ((format (printf, 2, 3)))
+    StackString& append(const char* fmt, ...) {
+        va_list ap;
+        va_start(ap, fmt);
+        set_length(len + vformat_to(buf + len, N - len, fmt, ap));
+        va_end(ap);
+        return *this;
+    }
+
+    void clear() {
+        buf[0] = '\0';
+        len = 0;
+        truncated = false;
+    }
+
+    const char* c_str() const { return buf; }
+    operator const char*() const { return buf; }
+    size_t size() const { return len; }
+
+    /**
+     * @return true if any output was cut off for lack of space
+     */
+    bool is_truncated() const { return truncated; }
+
+private:
+    char buf[N] = {};
+    size_t len = 0;
+    bool truncated = false;
+
+    void set_length(const size_t wanted) {
+        if (wanted >= N) {
+            truncated = true;
+            len = N - 1;
+        } else {
+            len = wanted;
+        }
+    }
+};
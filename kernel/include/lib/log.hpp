@@ -1,5 +1,8 @@
 #pragma once
 #include <cstdarg>
+#include <cstdint>
+
+#include "lib/fmt.hpp"
 
 enum LogLevel {
     LOG_LEVEL_DEBUG,
@@ -9,9 +12,28 @@ enum LogLevel {
     LOG_LEVEL_FATAL
 };
 
+#define LOG_LINE_MAX    240
+#define LOG_MAX_LINES   512
+
+/**
+ * A formatted log line as queued for the sinks
+ */
+struct LogRecord {
+    uint64_t timestamp; // tsc::now_ns()
+    LogLevel level;
+    uint16_t len;
+    char text[LOG_LINE_MAX];
+};
+
+/**
+ * Log lines are formatted into fixed-size records and queued on a lock-free
+ * ring, which is safe from any context and never blocks. flush() hands the
+ * queued records to the serial and on-screen console sinks; it runs from the
+ * main loop, and inline once the ring is half full outside of IRQ context.
+ */
 class Logger {
 public:
-    explicit Logger(const LogLevel initial = LOG_LEVEL_DEBUG) : log_level(initial) {
+    explicit constexpr Logger(const LogLevel initial = LOG_LEVEL_DEBUG) : log_level(initial) {
     }
     void vlog(LogLevel level, const char* fmt, va_list ap) const __attribute__((format(printf, 3, 0)));
     void log(LogLevel level, const char* fmt, ...) const __attribute__((format(printf, 3, 4)));
@@ -30,8 +52,63 @@ public:
     __attribute__ ((format (printf, 2, 3)))
     void fatal(const char* fmt, ...) const;
 
+    /**
+     * Type-checked variants taking an FMT() format string
+     */
+    template <typename Str, typename... Args, typename = fmt::if_format<Str>>
+    void log(const LogLevel level, const Str str, const Args&... args) const {
+        if (level < log_level) return;
+
+        LogRecord record;
+        const size_t len = fmt::format_to(record.text, sizeof(record.text), str, args...);
+        record.len = len < LOG_LINE_MAX ? len : LOG_LINE_MAX - 1;
+        submit(level, record);
+    }
+
+    template <typename Str, typename... Args, typename = fmt::if_format<Str>>
+    void debug(const Str str, const Args&... args) const { log(LOG_LEVEL_DEBUG, str, args...); }
+
+    template <typename Str, typename... Args, typename = fmt::if_format<Str>>
+    void info(const Str str, const Args&... args) const { log(LOG_LEVEL_INFO, str, args...); }
+
+    template <typename Str, typename... Args, typename = fmt::if_format<Str>>
+    void warn(const Str str, const Args&... args) const { log(LOG_LEVEL_WARN, str, args...); }
+
+    template <typename Str, typename... Args, typename = fmt::if_format<Str>>
+    void error(const Str str, const Args&... args) const { log(LOG_LEVEL_ERROR, str, args...); }
+
+    template <typename Str, typename... Args, typename = fmt::if_format<Str>>
+    void fatal(const Str str, const Args&... args) const { log(LOG_LEVEL_FATAL, str, args...); }
+
+    /**
+     * Write every queued record to the sinks. Fatal records are flushed as
+     * soon as they are logged.
+     */
+    void flush() const;
+
+    /**
+     * Flush after every record, for debugging hangs where queued records
+     * would never be written
+     */
+    void set_sync(bool enabled);
+
+    /**
+     * Draw records on the screen, for before the game owns it
+     */
+    void set_console(bool enabled);
+
+    /**
+     * Records lost because the ring was full
+     */
+    uint64_t get_dropped() const;
+
 private:
     LogLevel log_level;
+
+    /**
+     * Stamp a formatted record and queue it
+     */
+    void submit(LogLevel level, LogRecord& record) const;
 };
 
 inline Logger logger(LOG_LEVEL_DEBUG);
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Fixed-size lock-free ring buffers for handing data from interrupt handlers
+ * (or other CPUs) to a single consumer. Capacity must be a power of two.
+ * Indices are free-running counters, so a ring holds exactly Capacity items.
+ * Pushing into a full ring drops the item and counts it in get_dropped().
+ *
+ * Everything is zero-initialized, so rings can be plain globals without a
+ * constructor having to run.
+ */
+
+/**
+ * One producer, one consumer. Interrupt handlers that cannot nest count as a
+ * single producer on one CPU.
+ */
+template <typename T, uint32_t Capacity>
+class SpscRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "ring capacity must be a power of two");
+
+public:
+    /**
+     * @return false if the ring is full and the item was dropped
+     */
+    bool push(const T& item) {
+        return push_batch(&item, 1) == 1;
+    }
+
+    /**
+     * Push as many items as fit, publishing them all at once
+     * @return number of items pushed, the rest are counted as dropped
+     */
+    uint32_t push_batch(const T* src, uint32_t count) {
+        const uint32_t h = __atomic_load_n(&head, __ATOMIC_RELAXED);
+        const uint32_t free = Capacity - (h - __atomic_load_n(&tail, __ATOMIC_ACQUIRE));
+
+        if (count > free) {
+            __atomic_fetch_add(&dropped, count - free, __ATOMIC_RELAXED);
+            count = free;
+        }
+
+        for (uint32_t i = 0; i < count; i++) items[(h + i) & (Capacity - 1)] = src[i];
+        __atomic_store_n(&head, h + count, __ATOMIC_RELEASE);
+        return count;
+    }
+
+    /**
+     * @return false if the ring is empty
+     */
+    bool pop(T& out) {
+        return pop_batch(&out, 1) == 1;
+    }
+
+    /**
+     * Pop up to max items
+     * @return number of items popped
+     */
+    uint32_t pop_batch(T* dst, const uint32_t max) {
+        const uint32_t t = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+        uint32_t count = __atomic_load_n(&head, __ATOMIC_ACQUIRE) - t;
+        if (count > max) count = max;
+
+        for (uint32_t i = 0; i < count; i++) dst[i] = items[(t + i) & (Capacity - 1)];
+        __atomic_store_n(&tail, t + count, __ATOMIC_RELEASE);
+        return count;
+    }
+
+    bool empty() const {
+        return __atomic_load_n(&head, __ATOMIC_ACQUIRE) == __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+    }
+
+    uint32_t size() const {
+        return __atomic_load_n(&head, __ATOMIC_ACQUIRE) - __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+    }
+
+    uint64_t get_dropped() const {
+        return __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+    }
+
+private:
+    T items[Capacity] = {};
+    uint32_t head = 0; // next slot to write, only stored by the producer
+    uint32_t tail = 0; // next slot to read, only stored by the consumer
+    uint64_t dropped = 0;
+};
+
+/**
+ * Any number of producers, one consumer. Producers reserve slots by advancing
+ * head with a CAS and publish each one through its sequence number, so a
+ * producer interrupted between the two only holds back the consumer, never
+ * another producer.
+ */
+template <typename T, uint32_t Capacity>
+class MpscRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "ring capacity must be a power of two");
+
+public:
+    /**
+     * @return false if the ring is full and the item was dropped
+     */
+    bool push(const T& item) {
+        return push_batch(&item, 1) == 1;
+    }
+
+    /**
+     * Reserve as many consecutive slots as fit and fill them. The items of one
+     * batch stay together, but are published one by one.
+     * @return number of items pushed, the rest are counted as dropped
+     */
+    uint32_t push_batch(const T* src, const uint32_t count) {
+        uint32_t h = __atomic_load_n(&head, __ATOMIC_RELAXED);
+        uint32_t n;
+        do {
+            const uint32_t free = Capacity - (h - __atomic_load_n(&tail, __ATOMIC_ACQUIRE));
+            n = count < free ? count : free;
+            if (n == 0) break;
+        } while (!__atomic_compare_exchange_n(&head, &h, h + n, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+        if (n < count) __atomic_fetch_add(&dropped, count - n, __ATOMIC_RELAXED);
+
+        for (uint32_t i = 0; i < n; i++) {
+            Cell& cell = cells[(h + i) & (Capacity - 1)];
+            cell.value = src[i];
+            __atomic_store_n(&cell.sequence, lap(h + i) + 1, __ATOMIC_RELEASE);
+        }
+        return n;
+    }
+
+    /**
+     * @return false if the ring is empty or the oldest item is not published yet
+     */
+    bool pop(T& out) {
+        return pop_batch(&out, 1) == 1;
+    }
+
+    /**
+     * Pop up to max items, stopping at the first one not yet published
+     * @return number of items popped
+     */
+    uint32_t pop_batch(T* dst, const uint32_t max) {
+        const uint32_t t = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+        uint32_t count = 0;
+
+        for (; count < max; count++) {
+            Cell& cell = cells[(t + count) & (Capacity - 1)];
+            if (__atomic_load_n(&cell.sequence, __ATOMIC_ACQUIRE) != lap(t + count) + 1) break;
+            dst[count] = cell.value;
+        }
+
+        __atomic_store_n(&tail, t + count, __ATOMIC_RELEASE);
+        return count;
+    }
+
+    bool empty() const {
+        const uint32_t t = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+        return __atomic_load_n(&cells[t & (Capacity - 1)].sequence, __ATOMIC_ACQUIRE) != lap(t) + 1;
+    }
+
+    /**
+     * Number of slots in use, including ones reserved but not yet published
+     */
+    uint32_t size() const {
+        return __atomic_load_n(&head, __ATOMIC_ACQUIRE) - __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+    }
+
+    uint64_t get_dropped() const {
+        return __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+    }
+
+private:
+    struct Cell {
+        // Position of the slot's last write rounded down to the lap, plus one
+        // once published. Zero, the initial value, is free for the first lap.
+        uint32_t sequence;
+        T value;
+    };
+
+    Cell cells[Capacity] = {};
+    uint32_t head = 0; // next slot to reserve
+    uint32_t tail = 0; // next slot to read, only stored by the consumer
+    uint64_t dropped = 0;
+
+    static uint32_t lap(const uint32_t position) {
+        return position & ~(Capacity - 1);
+    }
+};
@@ -2,10 +2,38 @@
 
 #include <cstddef>
 
+/**
+ * Freestanding string functions with the usual C semantics. The scanning
+ * ones work a 64-bit word at a time and only ever read aligned words, so they
+ * may look at bytes past the end of a string but never across a page boundary.
+ */
+
 size_t strlen(const char* str);
 
+/**
+ * @return length of str, or max if no terminator is found in the first max bytes
+ */
+size_t strnlen(const char* str, size_t max);
+
+void* memchr(const void* ptr, int value, size_t count);
+
+char* strchr(const char* str, int ch);
+
+int strcmp(const char* a, const char* b);
+
+int strncmp(const char* a, const char* b, size_t count);
+
 char* strcpy(char* destination, const char* source);
 
+/**
+ * Copy at most count characters, padding the rest of destination with zeros.
+ * Like the C function, destination is not terminated if source is too long.
+ */
+char* strncpy(char* destination, const char* source, size_t count);
+
 char* strcat(char* destination, const char* source);
 
-char* strncat(char* destination, const char* source, size_t count);
\ No newline at end of file
+/**
+ * Append at most count characters of source, always terminating destination
+ */
+char* strncat(char* destination, const char* source, size_t count);
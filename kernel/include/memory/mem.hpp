@@ -56,4 +56,6 @@ namespace mem {
     size_t get_free_memory();  // In bytes
     size_t get_used_memory();  // In bytes
     size_t get_total_memory(); // In bytes
+
+    size_t get_heap_used(); // In bytes, malloc never gives memory back
 }
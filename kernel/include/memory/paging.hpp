@@ -1,9 +1,17 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 constexpr uint64_t PAGE_SIZE = 4096;
 
 namespace paging {
     void init();
+
+    /**
+     * Map a physical MMIO range uncached at its HHDM address, which Limine
+     * only sets up for RAM. Pages that are already mapped are left alone.
+     * @return virtual address of phys
+     */
+    void* map_mmio(uint64_t phys, size_t size);
 };
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tetris/engine.hpp"
+
+/**
+ * Placement-search agent. Scores every reachable (rotation, column) placement
+ * of the current piece, and for each of those every placement of the next
+ * piece, with a weighted board heuristic.
+ */
+
+/**
+ * Heuristic weights, scaled by 1000
+ */
+struct AiWeights {
+    int32_t aggregate_height;
+    int32_t lines;
+    int32_t holes;
+    int32_t bumpiness;
+};
+
+constexpr AiWeights AI_DEFAULT_WEIGHTS = {-510, 761, -357, -184};
+
+struct AiPlacement {
+    uint8_t rotation;
+    int8_t x;
+    int32_t score;
+    bool valid;
+};
+
+class TetrisAi {
+public:
+    void set_weights(const AiWeights& w) { weights = w; }
+
+    /**
+     * Search for the best placement of the engine's current piece
+     */
+    AiPlacement search(const TetrisEngine& engine);
+
+    /**
+     * Next action to play towards the best placement. Replans whenever a new
+     * piece spawns and starts or restarts the game when it is over.
+     */
+    Action next_action(const TetrisEngine& engine);
+
+    /**
+     * Number of board positions evaluated so far
+     */
+    uint64_t get_nodes() const { return nodes; }
+
+private:
+    AiWeights weights = AI_DEFAULT_WEIGHTS;
+    uint64_t nodes = 0;
+
+    AiPlacement plan = {};
+    uint32_t plan_piece = 0;
+    uint8_t rotate_attempts = 0;
+    int8_t last_x = 0;
+    bool moved = false;
+};
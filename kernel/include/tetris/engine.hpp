@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Freestanding Tetris rules engine. Has no dependency on the screen, logger or
+ * keyboard drivers so it can be built both into the kernel and for the host.
+ */
+
+#define PIECE_SIZE 4
+
+namespace TetrisConfig {
+    constexpr uint16_t BOARD_HEIGHT = 20;
+    constexpr uint16_t BOARD_WIDTH = 10;
+    constexpr uint32_t FRAMES_PER_SECOND = 100;
+    constexpr uint32_t INITIAL_FRAMES_PER_DROP = 100;
+    constexpr uint32_t LINES_PER_LEVEL = 10;
+    constexpr uint32_t MIN_FRAMES_PER_DROP = 10;
+    constexpr uint32_t BORDER_COLOR = 0x333333;
+}
+
+enum PieceType : uint8_t {
+    PIECE_I = 0,
+    PIECE_J = 1,
+    PIECE_T = 2,
+    PIECE_L = 3,
+    PIECE_O = 4,
+    PIECE_Z = 5,
+    PIECE_S = 6
+};
+
+enum GameState {
+    STATE_START,
+    STATE_ACTIVE,
+    STATE_PAUSED,
+    STATE_GAME_OVER
+};
+
+enum Action : uint8_t {
+    ACTION_NONE,
+    ACTION_MOVE_LEFT,
+    ACTION_MOVE_RIGHT,
+    ACTION_SOFT_DROP,
+    ACTION_HARD_DROP,
+    ACTION_ROTATE_CW,
+    ACTION_ROTATE_CCW,
+    ACTION_START,
+    ACTION_PAUSE,
+    ACTION_RESTART
+};
+
+struct Tile {
+    uint32_t color;
+};
+
+struct PieceDef {
+    uint8_t minos[PIECE_SIZE][PIECE_SIZE];
+    uint32_t color;
+};
+
+struct Tetromino {
+    PieceDef def;
+    int8_t x;
+    int8_t y;
+    uint8_t type;
+    uint8_t rotation; // number of clockwise quarter turns from the spawn orientation
+};
+
+extern const PieceDef PIECE_DEFS[7];
+
+/**
+ * Rotate a piece matrix by a quarter turn. dx/dy receive the offset that
+ * keeps the piece centered, which the engine applies to the piece position.
+ * @return false if the matrix is empty
+ */
+bool compute_rotation(
+    uint8_t dst[PIECE_SIZE][PIECE_SIZE],
+    const uint8_t src[PIECE_SIZE][PIECE_SIZE],
+    bool clockwise,
+    int8_t& dx,
+    int8_t& dy
+);
+
+class TetrisEngine {
+public:
+    /**
+     * Reset the game to the start screen and reseed the piece generator
+     */
+    void reset(uint32_t seed);
+
+    /**
+     * Restart the game, keeping the current piece generator state
+     */
+    void restart();
+
+    /**
+     * Apply a single player action
+     */
+    void apply(Action action);
+
+    /**
+     * Advance the simulation by one frame (gravity and game clock)
+     */
+    void tick();
+
+    bool collides(const uint8_t piece[PIECE_SIZE][PIECE_SIZE], int8_t x, int8_t y) const;
+
+    /**
+     * Rotate a piece in place if the rotated piece fits on the board
+     * @return false if the rotation is blocked
+     */
+    bool rotate_piece(Tetromino &piece, bool clockwise) const;
+
+    /**
+     * Lock a piece into the board and clear any completed lines
+     */
+    void lock(const Tetromino& piece);
+
+    /**
+     * A piece of the given type in its spawn position
+     */
+    static Tetromino spawn(uint8_t type);
+
+    GameState get_state() const { return state; }
+    const Tetromino& get_held() const { return held; }
+    uint8_t get_next_piece() const { return next_piece_index; }
+    uint32_t get_tile(const uint8_t x, const uint8_t y) const { return board[y][x].color; }
+    uint32_t get_time() const { return time; }
+    uint32_t get_score() const { return score; }
+    uint32_t get_level() const { return level; }
+    uint32_t get_full_lines() const { return full_lines; }
+    uint32_t get_piece_count() const { return piece_count; }
+
+    /**
+     * Counter bumped whenever the visible game state may have changed, so a
+     * front end can skip redrawing frames where nothing happened
+     */
+    uint32_t get_revision() const { return revision; }
+
+private:
+    Tetromino held = {};
+    Tile board[TetrisConfig::BOARD_HEIGHT][TetrisConfig::BOARD_WIDTH] = {};
+    GameState state = STATE_START;
+    uint32_t time = 0, score = 0, level = 1, full_lines = 0;
+
+    uint8_t bag_pieces[7] = {};
+    uint8_t bag_size = 0;
+    uint8_t next_piece_index = 0;
+    uint32_t piece_count = 0;
+
+    uint32_t frame_counter = 0;
+    uint32_t seconds_counter = 0;
+    uint32_t frames_per_drop = TetrisConfig::INITIAL_FRAMES_PER_DROP;
+
+    uint64_t rng_state = 1;
+    uint32_t revision = 0;
+
+    int rand();
+
+    void move(int8_t dir_x, int8_t dir_y);
+    void hard_drop();
+
+    void new_piece();
+    void drop_piece();
+    void check_row();
+};
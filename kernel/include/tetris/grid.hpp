@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Stress mode that simulates and renders many boards at once, each driven by
+ * its own agent or by a replay log, tiled across the framebuffer. The number
+ * of boards doubles every few seconds up to the requested count, and the
+ * simulated move rate and frame time are logged at each step.
+ */
+
+#define GRID_MAX_BOARDS 64
+
+class TetrisGrid {
+public:
+    /**
+     * Start the grid with up to count boards, seeded from seed. If a replay log
+     * is given every board plays it back in a loop instead of using the agent.
+     */
+    static void init(uint32_t count, uint32_t seed, const uint8_t* replay, size_t replay_size);
+
+    static void update();
+
+private:
+    static uint32_t board_count;
+    static uint32_t target_count;
+
+    static void layout();
+    static void add_boards(uint32_t count);
+    static void report();
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "driver/ps2/keyboard.hpp"
+#include "tetris/engine.hpp"
+
+/**
+ * Map a keyboard event to the engine action it triggers in the given state
+ * @return ACTION_NONE if the key is unbound or released
+ */
+Action key_to_action(KeyEvent ev, GameState state);
+
+/**
+ * Map a character received over serial to the key with the same binding, so
+ * the game can be played from a terminal without a PS/2 keyboard
+ * @return false if the character is unbound
+ */
+bool char_to_key(char c, uint8_t& scancode);
+
+/**
+ * Map an action to a key that triggers it in the state it is valid in, so
+ * the AI can play through the same input path as a player
+ * @return false for ACTION_NONE
+ */
+bool action_to_key(Action action, uint8_t& scancode);
+
+#define DEFAULT_DAS_TICKS       17  // 170 ms
+#define DEFAULT_ARR_TICKS       3
+#define DEFAULT_SOFT_DROP_TICKS 3
+
+/**
+ * Auto-repeat timings in simulation ticks
+ */
+struct RepeatConfig {
+    uint8_t das_ticks;       // delay before a held left/right starts repeating
+    uint8_t arr_ticks;       // ticks between repeats, 0 shifts to the wall at once
+    uint8_t soft_drop_ticks; // ticks between repeats of a held soft drop
+};
+
+/**
+ * Turns key presses and releases into engine actions, repeating held moves
+ * with delayed auto shift (DAS) and auto repeat rate (ARR) counted in
+ * simulation ticks. As repeats depend only on the key events and the tick
+ * they arrive on, replays reproduce them exactly. Make codes for a key that
+ * is already held, such as keyboard typematic repeats, are ignored.
+ */
+class InputController {
+public:
+    void configure(RepeatConfig repeat);
+
+    /**
+     * Release every key
+     */
+    void reset();
+
+    /**
+     * Apply a key event to the engine
+     * @return the action applied, ACTION_NONE if the event had no effect
+     */
+    Action key(TetrisEngine& engine, KeyEvent ev);
+
+    /**
+     * Apply the repeats due this tick. Call once per tick, before engine.tick().
+     * @return number of actions applied
+     */
+    uint32_t tick(TetrisEngine& engine);
+
+private:
+    RepeatConfig timing = {DEFAULT_DAS_TICKS, DEFAULT_ARR_TICKS, DEFAULT_SOFT_DROP_TICKS};
+
+    bool left = false, right = false, down = false;
+    Action shift = ACTION_NONE; // most recently pressed horizontal direction still held
+    uint32_t shift_ticks = 0;
+    uint32_t drop_ticks = 0;
+
+    void press_shift(Action direction);
+    void release_shift(Action direction);
+    uint32_t repeat_shift(TetrisEngine& engine);
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tetris/engine.hpp"
+
+/**
+ * Move-generation benchmark in the style of chess perft. Counts the distinct
+ * lock positions reachable through left/right moves, soft drops and rotations
+ * (with the engine's centering offsets), placing the pieces of the queue one
+ * after another. Two paths ending in the same set of cells count once.
+ */
+
+#define PERFT_MAX_DEPTH 8
+
+/**
+ * Count the leaf lock positions after placing depth pieces from queue onto
+ * the engine's board. queue must hold at least depth piece types.
+ */
+uint64_t perft(const TetrisEngine& engine, const uint8_t* queue, uint8_t depth);
+
+/**
+ * Parse a queue of piece letters (IJTLOZS)
+ * @return number of pieces parsed, or -1 on an unknown letter
+ */
+int perft_parse_queue(const char* str, uint8_t* queue, uint8_t max);
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+#include "tetris/engine.hpp"
+
+/**
+ * Draw a single shaded block. Blocks smaller than 3 pixels are drawn flat.
+ */
+void draw_tile(uint32_t x, uint32_t y, uint16_t size, uint32_t color);
+
+/**
+ * Draw the locked tiles and the active piece of a board with its top left
+ * corner at (x, y)
+ */
+void draw_board(const TetrisEngine& engine, int32_t x, int32_t y, uint16_t block_size);
+
+/**
+ * Draw the frame timing HUD with its top left corner at (x, y): FPS, frame
+ * times, input latency percentiles, the per-phase breakdown, heap use and IRQ
+ * rates as text, and a sparkline of the recent frame times underneath
+ */
+void draw_hud(uint32_t x, uint32_t y, float scale);
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "driver/ps2/keyboard.hpp"
+#include "tetris/engine.hpp"
+#include "tetris/input.hpp"
+
+/**
+ * Replay log format (little endian):
+ *   header:  "TRPL" magic, u8 version, u32 RNG seed,
+ *            u8 DAS, ARR and soft drop repeat ticks
+ *   records: LEB128 simulation tick delta since the previous record,
+ *            u8 scancode, u8 flags (bit 0 = break, bit 1 = extended)
+ *
+ * An event recorded at tick N is applied before the engine's Nth tick, and
+ * held keys repeat through an InputController with the recorded timings.
+ */
+
+#define REPLAY_VERSION      2
+#define REPLAY_HEADER_SIZE  12
+
+#define REPLAY_FLAG_BREAK       0x01
+#define REPLAY_FLAG_EXTENDED    0x02
+
+class ReplayRecorder {
+public:
+    void begin(uint8_t* buffer, size_t capacity, uint32_t seed, RepeatConfig repeat);
+
+    /**
+     * Append an event to the log
+     * @return false if the buffer is full and the event was dropped
+     */
+    bool record(uint64_t tick, KeyEvent ev);
+
+    const uint8_t* data() const { return buf; }
+    size_t size() const { return len; }
+    bool overflowed() const { return overflow; }
+
+private:
+    uint8_t* buf = nullptr;
+    size_t cap = 0;
+    size_t len = 0;
+    uint64_t last_tick = 0;
+    bool overflow = false;
+};
+
+class ReplayReader {
+public:
+    /**
+     * @return false if the data is not a replay log this version understands
+     */
+    bool open(const uint8_t* data, size_t size);
+
+    uint32_t get_seed() const { return seed; }
+    RepeatConfig get_repeat() const { return repeat; }
+
+    bool done() const { return !has_pending; }
+
+    /**
+     * Tick of the next pending event, only valid while !done()
+     */
+    uint64_t next_tick() const { return pending_tick; }
+
+    /**
+     * Pop the next pending event
+     */
+    bool next(KeyEvent& ev);
+
+private:
+    const uint8_t* buf = nullptr;
+    size_t len = 0;
+    size_t pos = 0;
+    uint32_t seed = 0;
+    RepeatConfig repeat = {};
+
+    bool has_pending = false;
+    uint64_t pending_tick = 0;
+    KeyEvent pending = {};
+
+    void decode_next();
+};
+
+struct ReplayResult {
+    uint64_t ticks;
+    uint64_t events;
+};
+
+/**
+ * Reseed the engine from the log and play every event back into it as fast
+ * as possible, without rendering
+ */
+ReplayResult replay_run(TetrisEngine& engine, ReplayReader& reader);
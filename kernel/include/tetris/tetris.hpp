@@ -1,71 +1,63 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include "driver/ps2/keyboard.hpp"
+#include "tetris/engine.hpp"
+#include "tetris/input.hpp"
 
-#define PIECE_SIZE 4
-
-enum PieceType : uint8_t {
-    PIECE_I = 0,
-    PIECE_J = 1,
-    PIECE_T = 2,
-    PIECE_L = 3,
-    PIECE_O = 4,
-    PIECE_Z = 5,
-    PIECE_S = 6
-};
+/**
+ * Kernel front end for the engine: owns the game instance, maps keyboard input
+ * to engine actions and renders the game to the screen.
+ */
+class Tetris {
+public:
+    static void init(uint32_t seed, RepeatConfig repeat);
 
-enum GameState {
-    STATE_START,
-    STATE_ACTIVE,
-    STATE_PAUSED,
-    STATE_GAME_OVER
-};
+    /**
+     * Advance the game by one frame
+     */
+    static void update();
 
-struct Tile {
-    uint32_t color;
-};
+    /**
+     * Redraw the screen with the current game state
+     */
+    static void render();
 
-struct PieceDef {
-    uint8_t minos[PIECE_SIZE][PIECE_SIZE];
-    uint32_t color;
-};
+    /**
+     * @return true if the game has changed since it was last rendered
+     */
+    static bool needs_redraw();
 
-struct Tetromino {
-    PieceDef def;
-    int8_t x;
-    int8_t y;
-};
+    /**
+     * @return true if update() would do nothing until the next key press,
+     * as no game is running and neither a replay nor the agent is playing
+     */
+    static bool is_idle();
 
-class Tetris {
-public:
-    static void init();
-    static void update();
     static void handle_key(KeyEvent ev);
 
-private:
-    static constexpr uint16_t board_height = 20;
-    static constexpr uint16_t board_width = 10;
-
-    static Tetromino held;
-    static Tile board[board_height][board_width];
-    static GameState state;
-    static uint32_t time, score, level, full_lines;
+    /**
+     * Play a replay log back into the game, either at normal speed or as fast
+     * as possible with rendering disabled. Stops recording the current session.
+     */
+    static bool play_replay(const uint8_t* data, size_t size, bool fast);
 
-    static uint8_t bag_pieces[7];
-    static uint8_t bag_size;
+    /**
+     * Let the built-in agent play the game
+     */
+    static void set_autoplay(bool enabled);
 
-    static bool collides(uint8_t piece[PIECE_SIZE][PIECE_SIZE], int8_t x, int8_t y);
-    static void move(int8_t dir_x, int8_t dir_y);
-    static bool rotate_piece(Tetromino &piece, bool clockwise);
-    static void rotate_cw();
-    static void rotate_ccw();
-    static void hard_drop();
+    /**
+     * Write the replay log of the current session to serial as hex
+     */
+    static void dump_replay();
 
-    static void new_piece();
-    static void drop_piece();
-    static void check_row();
+private:
+    static TetrisEngine engine;
+    static uint64_t sim_tick;
+    static uint32_t drawn_revision;
 
-    static void restart();
+    static void apply_key(KeyEvent ev);
     static void draw();
-};
\ No newline at end of file
+};
@@ -1,27 +1,74 @@
 BITS 64
 
-%assign i 0
-%rep 16
-    global irq_stub_%+i
+; Must match IRQ_BENCH_FULL_VECTOR in kernel/irq_bench.hpp
+%define IRQ_BENCH_FULL_VECTOR 0xF1
+
+; One stub for every vector from 32 up, the ISA IRQs, the local APIC timer and
+; performance counter overflow, software interrupts and the APIC spurious
+; vector alike. irq_handle looks each one up in its per-vector tables.
+; The gates are interrupt gates, so IF is already clear on entry.
+%assign i 32
+%rep 256 - 32
     irq_stub_%+i:
-        cli
         push 0
-        push i + 32
+        push i
         jmp irq_common_stub
 %assign i i+1
 %endrep
 
 global irq_stub_table
 irq_stub_table:
-%assign i 0
-%rep 16
+%assign i 32
+%rep 256 - 32
     dq irq_stub_%+i
 %assign i i+1
 %endrep
 
 extern irq_handle
-; https://github.com/i3vie/neutrino/blob/master/src/arch/x86_64/isr_stubs.S
+; irq_handle is a C function, so it preserves rbx and r12-r15 itself. Only the
+; caller-saved registers and rbp (for the profiler's stack walks) are saved,
+; into their slots of struct regs, and the other slots are left unset.
 irq_common_stub:
+    push rax
+    sub rsp, 8 ; rbx
+    push rcx
+    push rdx
+    push rsi
+    push rdi
+    push rbp
+    push r8
+    push r9
+    push r10
+    push r11
+    sub rsp, 32 ; r12-r15
+
+    mov rdi, rsp
+    call irq_handle
+
+    add rsp, 32
+    pop r11
+    pop r10
+    pop r9
+    pop r8
+    pop rbp
+    pop rdi
+    pop rsi
+    pop rdx
+    pop rcx
+    add rsp, 8
+    pop rax
+
+    add rsp, 16
+    iretq
+
+; The entry path as it was before, saving every register, kept for the
+; interrupt latency benchmark to compare against
+; https://github.com/i3vie/neutrino/blob/master/src/arch/x86_64/isr_stubs.S
+global irq_stub_full_bench
+irq_stub_full_bench:
+    cli
+    push 0
+    push IRQ_BENCH_FULL_VECTOR
     cli
     push rax
     push rbx
@@ -39,7 +86,7 @@ irq_common_stub:
     push r14
     push r15
 
-    mov rdi, rsp ; the stack coincidentally is shaped like a C struct so we can just throw that into C
+    mov rdi, rsp
     call irq_handle
 
     pop r15
@@ -59,4 +106,4 @@ irq_common_stub:
     pop rax
 
     add rsp, 16
-    iretq
\ No newline at end of file
+    iretq
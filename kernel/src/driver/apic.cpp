@@ -0,0 +1,297 @@
+#include "driver/apic.hpp"
+
+#include <uacpi/acpi.h>
+#include <uacpi/tables.h>
+
+#include "driver/pic.hpp"
+#include "driver/tsc.hpp"
+#include "kernel/system.hpp"
+#include "lib/log.hpp"
+#include "memory/paging.hpp"
+
+#define IA32_APIC_BASE          0x1B
+#define IA32_APIC_BASE_ENABLE   (1 << 11)
+#define IA32_TSC_DEADLINE       0x6E0
+
+#define CPUID_FEATURES          1
+#define CPUID_EDX_APIC          (1 << 9)
+#define CPUID_ECX_TSC_DEADLINE  (1 << 24)
+
+#define LAPIC_REG_ID            0x020
+#define LAPIC_REG_EOI           0x0B0
+#define LAPIC_REG_SVR           0x0F0
+#define LAPIC_REG_LVT_TIMER     0x320
+#define LAPIC_REG_LVT_PERF      0x340
+#define LAPIC_REG_TIMER_INITIAL 0x380
+#define LAPIC_REG_TIMER_CURRENT 0x390
+#define LAPIC_REG_TIMER_DIVIDE  0x3E0
+
+#define LAPIC_SVR_ENABLE        (1 << 8)
+#define LAPIC_LVT_MASKED        (1 << 16)
+#define LAPIC_TIMER_ONESHOT     (0 << 17)
+#define LAPIC_TIMER_TSC_DEADLINE (2 << 17)
+#define LAPIC_TIMER_DIVIDE_16   0x3
+
+#define IOAPIC_REG_SELECT       0x00
+#define IOAPIC_REG_WINDOW       0x10
+#define IOAPIC_REG_VERSION      0x01
+#define IOAPIC_REG_REDIRECT(n)  (0x10 + 2 * (n))
+
+#define IOAPIC_ACTIVE_LOW       (1 << 13)
+#define IOAPIC_LEVEL            (1 << 15)
+#define IOAPIC_MASKED           (1 << 16)
+
+#define MAX_IOAPICS             4
+#define ISA_IRQS                16
+
+#define CALIBRATE_NS            10000000
+
+namespace apic {
+    struct IoApic {
+        volatile uint32_t* base;
+        uint32_t gsi_base;
+        uint32_t gsi_count;
+    };
+
+    struct IsaRoute {
+        uint32_t gsi;
+        uint32_t flags; // polarity and trigger bits of the redirection entry
+    };
+
+    static volatile uint8_t* lapic = nullptr;
+    static uint8_t lapic_id = 0;
+    static bool enabled = false;
+
+    static IoApic ioapics[MAX_IOAPICS];
+    static uint8_t ioapic_count = 0;
+    static IsaRoute isa_routes[ISA_IRQS];
+
+    static bool timer_ready = false;
+    static bool tsc_deadline = false;
+    // LAPIC timer counts per ns as 32.32 fixed point
+    static uint64_t timer_mult = 0;
+
+    static uint32_t read(const uint32_t reg) {
+        return *reinterpret_cast<volatile uint32_t*>(lapic + reg);
+    }
+
+    static void write(const uint32_t reg, const uint32_t value) {
+        *reinterpret_cast<volatile uint32_t*>(lapic + reg) = value;
+    }
+
+    static uint32_t ioapic_read(const IoApic& io, const uint32_t reg) {
+        io.base[IOAPIC_REG_SELECT / 4] = reg;
+        return io.base[IOAPIC_REG_WINDOW / 4];
+    }
+
+    static void ioapic_write(const IoApic& io, const uint32_t reg, const uint32_t value) {
+        io.base[IOAPIC_REG_SELECT / 4] = reg;
+        io.base[IOAPIC_REG_WINDOW / 4] = value;
+    }
+
+    static IoApic* ioapic_for(const uint32_t gsi) {
+        for (uint8_t i = 0; i < ioapic_count; i++) {
+            if (gsi >= ioapics[i].gsi_base && gsi < ioapics[i].gsi_base + ioapics[i].gsi_count) return &ioapics[i];
+        }
+        return nullptr;
+    }
+
+    static void route_irq(const uint8_t irq, const bool masked) {
+        const IsaRoute& route = isa_routes[irq];
+        IoApic* io = ioapic_for(route.gsi);
+        if (!io) return;
+
+        const uint32_t entry = route.gsi - io->gsi_base;
+        ioapic_write(*io, IOAPIC_REG_REDIRECT(entry) + 1, static_cast<uint32_t>(lapic_id) << 24);
+        ioapic_write(
+            *io,
+            IOAPIC_REG_REDIRECT(entry),
+            (IRQ_VECTOR_BASE + irq) | route.flags | (masked ? IOAPIC_MASKED : 0)
+        );
+    }
+
+    bool route_gsi(const uint32_t gsi, const uint8_t irq) {
+        if (!enabled || gsi < ISA_IRQS) return false;
+        IoApic* io = ioapic_for(gsi);
+        if (!io) return false;
+
+        const uint32_t entry = gsi - io->gsi_base;
+        ioapic_write(*io, IOAPIC_REG_REDIRECT(entry) + 1, static_cast<uint32_t>(lapic_id) << 24);
+        ioapic_write(*io, IOAPIC_REG_REDIRECT(entry), IRQ_VECTOR_BASE + irq);
+        return true;
+    }
+
+    static void parse_madt(uint64_t& lapic_phys) {
+        for (uint8_t irq = 0; irq < ISA_IRQS; irq++) isa_routes[irq] = {irq, 0};
+
+        uacpi_table table;
+        if (uacpi_unlikely_error(uacpi_table_find_by_signature(ACPI_MADT_SIGNATURE, &table))) {
+            logger.warn("APIC: no MADT, using the APIC base MSR");
+            return;
+        }
+
+        const auto* madt = static_cast<const acpi_madt*>(table.ptr);
+        lapic_phys = madt->local_interrupt_controller_address;
+
+        const auto* entry = reinterpret_cast<const uint8_t*>(madt->entries);
+        const auto* end = reinterpret_cast<const uint8_t*>(madt) + madt->hdr.length;
+
+        while (entry + sizeof(acpi_entry_hdr) <= end) {
+            const auto* hdr = reinterpret_cast<const acpi_entry_hdr*>(entry);
+            if (hdr->length < sizeof(acpi_entry_hdr)) break;
+
+            switch (hdr->type) {
+                case ACPI_MADT_ENTRY_TYPE_IOAPIC: {
+                    if (ioapic_count == MAX_IOAPICS) break;
+                    const auto* ioapic = reinterpret_cast<const acpi_madt_ioapic*>(entry);
+
+                    IoApic& io = ioapics[ioapic_count++];
+                    io.base = static_cast<volatile uint32_t*>(paging::map_mmio(ioapic->address, 0x20));
+                    io.gsi_base = ioapic->gsi_base;
+                    io.gsi_count = ((ioapic_read(io, IOAPIC_REG_VERSION) >> 16) & 0xFF) + 1;
+                    break;
+                }
+                case ACPI_MADT_ENTRY_TYPE_INTERRUPT_SOURCE_OVERRIDE: {
+                    const auto* iso = reinterpret_cast<const acpi_madt_interrupt_source_override*>(entry);
+                    if (iso->bus != 0 || iso->source >= ISA_IRQS) break;
+
+                    uint32_t flags = 0;
+                    if ((iso->flags & ACPI_MADT_POLARITY_MASK) == ACPI_MADT_POLARITY_ACTIVE_LOW) flags |= IOAPIC_ACTIVE_LOW;
+                    if ((iso->flags & ACPI_MADT_TRIGGERING_MASK) == ACPI_MADT_TRIGGERING_LEVEL) flags |= IOAPIC_LEVEL;
+                    isa_routes[iso->source] = {iso->gsi, flags};
+                    break;
+                }
+                case ACPI_MADT_ENTRY_TYPE_LAPIC_ADDRESS_OVERRIDE: {
+                    lapic_phys = reinterpret_cast<const acpi_madt_lapic_address_override*>(entry)->address;
+                    break;
+                }
+                default:
+                    break;
+            }
+
+            entry += hdr->length;
+        }
+
+        uacpi_table_unref(&table);
+    }
+
+    void init() {
+        uint32_t eax, ebx, ecx, edx;
+        cpuid(CPUID_FEATURES, 0, eax, ebx, ecx, edx);
+        if (!(edx & CPUID_EDX_APIC)) {
+            logger.warn("APIC: not supported, staying on the PIC");
+            return;
+        }
+        tsc_deadline = ecx & CPUID_ECX_TSC_DEADLINE;
+
+        const uint64_t base_msr = rdmsr(IA32_APIC_BASE);
+        uint64_t lapic_phys = base_msr & 0x000FFFFFFFFFF000ull;
+        parse_madt(lapic_phys);
+
+        if (ioapic_count == 0) {
+            logger.warn("APIC: no I/O APIC, staying on the PIC");
+            return;
+        }
+
+        wrmsr(IA32_APIC_BASE, base_msr | IA32_APIC_BASE_ENABLE);
+        lapic = static_cast<volatile uint8_t*>(paging::map_mmio(lapic_phys, 0x1000));
+        lapic_id = read(LAPIC_REG_ID) >> 24;
+        write(LAPIC_REG_SVR, LAPIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+        write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED);
+        write(LAPIC_REG_LVT_PERF, LAPIC_LVT_MASKED);
+
+        // Carry over whatever the PIC had unmasked, then switch it off
+        const uint16_t pic_mask = inb(PIC1_DATA) | (inb(PIC2_DATA) << 8);
+        for (uint8_t irq = 0; irq < ISA_IRQS; irq++) {
+            if (irq == CASCADE_IRQ) continue;
+            route_irq(irq, pic_mask & (1 << irq));
+        }
+        pic::disable();
+        irq_use_apic_eoi();
+        enabled = true;
+
+        logger.info(FMT("APIC: local APIC %d at 0x%x, %d I/O APIC(s)"), lapic_id, lapic_phys, ioapic_count);
+    }
+
+    bool is_enabled() {
+        return enabled;
+    }
+
+    void eoi() {
+        write(LAPIC_REG_EOI, 0);
+    }
+
+    void mask_irq(const uint8_t irq) {
+        if (irq < ISA_IRQS) route_irq(irq, true);
+    }
+
+    void unmask_irq(const uint8_t irq) {
+        if (irq < ISA_IRQS && irq != CASCADE_IRQ) route_irq(irq, false);
+    }
+
+    void apic_start_timer() {
+        if (!enabled) return;
+        if (tsc::get_frequency() == 0) {
+            logger.warn("APIC: TSC not calibrated, timer disabled");
+            return;
+        }
+
+        if (tsc_deadline) {
+            write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_TSC_DEADLINE | (IRQ_VECTOR_BASE + APIC_TIMER_IRQ));
+            timer_ready = true;
+            logger.info("APIC: timer in TSC-deadline mode");
+            return;
+        }
+
+        // Count down from the maximum over a fixed TSC interval
+        write(LAPIC_REG_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_16);
+        write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED);
+        write(LAPIC_REG_TIMER_INITIAL, 0xFFFFFFFF);
+        const uint64_t start = tsc::now_ns();
+        while (tsc::now_ns() - start < CALIBRATE_NS) asm volatile("pause");
+        const uint32_t counted = 0xFFFFFFFF - read(LAPIC_REG_TIMER_CURRENT);
+        write(LAPIC_REG_TIMER_INITIAL, 0);
+
+        if (counted == 0) {
+            logger.warn("APIC: timer calibration failed");
+            return;
+        }
+
+        timer_mult = (static_cast<uint64_t>(counted) << 32) / CALIBRATE_NS;
+        write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_ONESHOT | (IRQ_VECTOR_BASE + APIC_TIMER_IRQ));
+        timer_ready = true;
+
+        logger.info(FMT("APIC: timer in one-shot mode at %u kHz"), static_cast<uint64_t>(counted) * 1000000 / CALIBRATE_NS);
+    }
+
+    bool has_timer() {
+        return timer_ready;
+    }
+
+    bool has_tsc_deadline() {
+        return tsc_deadline && timer_ready;
+    }
+
+    void set_deadline(const uint64_t deadline_ns) {
+        if (!timer_ready) return;
+
+        const uint64_t now = tsc::now_ns();
+        const uint64_t delta_ns = deadline_ns > now ? deadline_ns - now : 0;
+
+        if (tsc_deadline) {
+            wrmsr(IA32_TSC_DEADLINE, tsc::now_cycles() + tsc::ns_to_cycles(delta_ns));
+            return;
+        }
+
+        uint64_t count = (static_cast<unsigned __int128>(delta_ns) * timer_mult) >> 32;
+        if (count == 0) count = 1;
+        if (count > 0xFFFFFFFF) count = 0xFFFFFFFF;
+        write(LAPIC_REG_TIMER_INITIAL, static_cast<uint32_t>(count));
+    }
+
+    bool set_pmu_interrupt(const bool enable) {
+        if (!enabled) return false;
+        write(LAPIC_REG_LVT_PERF, enable ? IRQ_VECTOR_BASE + APIC_PMU_IRQ : LAPIC_LVT_MASKED);
+        return true;
+    }
+}
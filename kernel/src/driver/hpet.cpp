@@ -0,0 +1,228 @@
+#include "driver/hpet.hpp"
+
+#include <uacpi/acpi.h>
+#include <uacpi/tables.h>
+
+#include "driver/apic.hpp"
+#include "driver/pic.hpp"
+#include "kernel/system.hpp"
+#include "lib/log.hpp"
+#include "memory/paging.hpp"
+
+#define HPET_MMIO_SIZE          0x400
+
+#define HPET_REG_CAPS           0x000
+#define HPET_REG_CONFIG         0x010
+#define HPET_REG_INT_STATUS     0x020
+#define HPET_REG_COUNTER        0x0F0
+#define HPET_REG_TIMER_CONFIG(n) (0x100 + 0x20 * (n))
+#define HPET_REG_TIMER_COMP(n)   (0x108 + 0x20 * (n))
+
+#define HPET_CAPS_COUNT_64      (1ull << 13)
+#define HPET_CAPS_NUM_TIMERS(c) ((((c) >> 8) & 0x1F) + 1)
+#define HPET_CAPS_PERIOD_FS(c)  ((c) >> 32)
+
+#define HPET_CONFIG_ENABLE      (1ull << 0)
+#define HPET_CONFIG_LEGACY      (1ull << 1)
+
+#define HPET_TIMER_LEVEL        (1ull << 1)
+#define HPET_TIMER_ENABLE       (1ull << 2)
+#define HPET_TIMER_PERIODIC     (1ull << 3)
+#define HPET_TIMER_32BIT        (1ull << 8)
+#define HPET_TIMER_ROUTE_SHIFT  9
+#define HPET_TIMER_ROUTE_MASK   (0x1Full << HPET_TIMER_ROUTE_SHIFT)
+#define HPET_TIMER_ROUTE_CAP(c) ((c) >> 32)
+
+#define FS_PER_NS               1000000
+#define ISA_IRQS                16
+// Longer one-shots are cut short, callers re-arm. Keeps delay_ns * FS_PER_NS
+// in range and a 32-bit comparator within half its wrap.
+#define ONESHOT_MAX_NS          10000000000ull
+
+namespace hpet {
+    static volatile uint8_t* base = nullptr;
+    static uint64_t period_fs = 0;
+    static bool counter_64 = false;
+    // ns = ticks * ns_mult >> 32
+    static uint64_t ns_mult = 0;
+
+    // A 32-bit counter wraps every few minutes, so elapsed time is accumulated
+    static uint64_t last_counter = 0;
+    static uint64_t elapsed_ticks = 0;
+
+    static int8_t oneshot_timer = -1;
+    static uint8_t oneshot_gsi = 0;
+    static bool oneshot_routed = false;
+    static oneshot_callback callback = nullptr;
+
+    static uint64_t read_reg(const uint32_t reg) {
+        return *reinterpret_cast<volatile uint64_t*>(base + reg);
+    }
+
+    static void write_reg(const uint32_t reg, const uint64_t value) {
+        *reinterpret_cast<volatile uint64_t*>(base + reg) = value;
+    }
+
+    static void hpet_handler(regs* r) {
+        (void)r;
+        if (callback) callback();
+    }
+
+    /**
+     * Find a comparator that can interrupt on an I/O APIC input above the ISA
+     * IRQs, without legacy replacement mode, which would take IRQ 0 and 8
+     */
+    static void setup_oneshot(const uint8_t timer_count) {
+        for (uint8_t timer = timer_count - 1; timer < timer_count; timer--) {
+            const uint64_t config = read_reg(HPET_REG_TIMER_CONFIG(timer));
+            const uint32_t route_cap = HPET_TIMER_ROUTE_CAP(config);
+
+            for (uint8_t gsi = 31; gsi >= ISA_IRQS; gsi--) {
+                if (!(route_cap & (1u << gsi))) continue;
+
+                oneshot_timer = timer;
+                oneshot_gsi = gsi;
+
+                // Edge triggered and disabled until armed
+                write_reg(
+                    HPET_REG_TIMER_CONFIG(timer),
+                    (config & ~(HPET_TIMER_LEVEL | HPET_TIMER_ENABLE | HPET_TIMER_PERIODIC | HPET_TIMER_ROUTE_MASK))
+                    | (static_cast<uint64_t>(gsi) << HPET_TIMER_ROUTE_SHIFT)
+                );
+                return;
+            }
+        }
+    }
+
+    bool init() {
+        uacpi_table table;
+        if (uacpi_unlikely_error(uacpi_table_find_by_signature(ACPI_HPET_SIGNATURE, &table))) {
+            logger.info("HPET: no HPET table");
+            return false;
+        }
+
+        const auto* hpet_table = static_cast<const acpi_hpet*>(table.ptr);
+        const uint64_t phys = hpet_table->address.address;
+        const bool in_memory = hpet_table->address.address_space_id == ACPI_AS_ID_SYS_MEM;
+        uacpi_table_unref(&table);
+
+        if (!in_memory || phys == 0) {
+            logger.warn("HPET: unsupported register block address");
+            return false;
+        }
+
+        base = static_cast<volatile uint8_t*>(paging::map_mmio(phys, HPET_MMIO_SIZE));
+
+        const uint64_t caps = read_reg(HPET_REG_CAPS);
+        period_fs = HPET_CAPS_PERIOD_FS(caps);
+        if (period_fs == 0 || period_fs > 100000000) {
+            logger.warn(FMT("HPET: invalid counter period %u fs"), period_fs);
+            base = nullptr;
+            return false;
+        }
+        counter_64 = caps & HPET_CAPS_COUNT_64;
+        ns_mult = (period_fs << 32) / FS_PER_NS;
+
+        const uint8_t timer_count = HPET_CAPS_NUM_TIMERS(caps);
+
+        // Stop the counter while configuring the comparators, then start it
+        const uint64_t config = read_reg(HPET_REG_CONFIG) & ~(HPET_CONFIG_ENABLE | HPET_CONFIG_LEGACY);
+        write_reg(HPET_REG_CONFIG, config);
+        for (uint8_t timer = 0; timer < timer_count; timer++) {
+            write_reg(HPET_REG_TIMER_CONFIG(timer), read_reg(HPET_REG_TIMER_CONFIG(timer)) & ~HPET_TIMER_ENABLE);
+        }
+        setup_oneshot(timer_count);
+        write_reg(HPET_REG_CONFIG, config | HPET_CONFIG_ENABLE);
+
+        last_counter = read_counter();
+        elapsed_ticks = 0;
+
+        logger.info(
+            "HPET: %lu kHz, %d comparators, %d-bit counter",
+            get_frequency() / 1000,
+            timer_count,
+            counter_64 ? 64 : 32
+        );
+        if (oneshot_timer >= 0) {
+            logger.info("HPET: one-shot events on comparator %d, GSI %d", oneshot_timer, oneshot_gsi);
+        } else {
+            logger.info("HPET: no comparator can be routed above the ISA IRQs, no one-shot events");
+        }
+
+        return true;
+    }
+
+    bool is_available() {
+        return base != nullptr;
+    }
+
+    uint64_t get_frequency() {
+        return period_fs ? 1000000000000000ull / period_fs : 0;
+    }
+
+    uint64_t read_counter() {
+        const uint64_t counter = read_reg(HPET_REG_COUNTER);
+        return counter_64 ? counter : counter & 0xFFFFFFFF;
+    }
+
+    static bool counter_passed(const uint64_t counter, const uint64_t deadline) {
+        if (counter_64) return static_cast<int64_t>(counter - deadline) >= 0;
+        return static_cast<int32_t>(static_cast<uint32_t>(counter - deadline)) >= 0;
+    }
+
+    uint64_t now_ns() {
+        if (!base) return 0;
+
+        // Also called from IRQ handlers, which must not interleave with the update
+        const uint64_t flags = irq_save();
+        const uint64_t counter = read_counter();
+        elapsed_ticks += counter_64 ? counter - last_counter : (counter - last_counter) & 0xFFFFFFFF;
+        last_counter = counter;
+        const uint64_t ticks = elapsed_ticks;
+        irq_restore(flags);
+
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(ticks) * ns_mult) >> 32);
+    }
+
+    bool start_oneshot(const oneshot_callback cb) {
+        if (!base || oneshot_timer < 0) return false;
+        if (!oneshot_routed) {
+            if (!apic::route_gsi(oneshot_gsi, APIC_HPET_IRQ)) return false;
+            irq_install_handler(APIC_HPET_IRQ, hpet_handler);
+            oneshot_routed = true;
+        }
+
+        callback = cb;
+        return true;
+    }
+
+    bool arm_oneshot(uint64_t delay_ns) {
+        if (!oneshot_routed) return false;
+
+        if (delay_ns > ONESHOT_MAX_NS) delay_ns = ONESHOT_MAX_NS;
+        uint64_t ticks = delay_ns * FS_PER_NS / period_fs;
+        if (ticks == 0) ticks = 1;
+
+        const uint32_t reg = HPET_REG_TIMER_CONFIG(oneshot_timer);
+        const uint64_t deadline = read_counter() + ticks;
+
+        write_reg(reg, read_reg(reg) | HPET_TIMER_ENABLE);
+        write_reg(HPET_REG_TIMER_COMP(oneshot_timer), counter_64 ? deadline : deadline & 0xFFFFFFFF);
+
+        // The comparator only fires on an exact match, so a deadline that
+        // passed while it was being written would never fire
+        if (counter_passed(read_counter(), deadline) && callback) {
+            disarm_oneshot();
+            callback();
+        }
+
+        return true;
+    }
+
+    void disarm_oneshot() {
+        if (!oneshot_routed) return;
+
+        const uint32_t reg = HPET_REG_TIMER_CONFIG(oneshot_timer);
+        write_reg(reg, read_reg(reg) & ~HPET_TIMER_ENABLE);
+    }
+}
@@ -45,4 +45,10 @@ namespace limine_requests {
         .id = LIMINE_RSDP_REQUEST_ID,
         .revision = 0
     };
+
+    __attribute__((used, section(".limine_requests")))
+    volatile limine_module_request module_request = {
+        .id = LIMINE_MODULE_REQUEST_ID,
+        .revision = 0
+    };
 }
\ No newline at end of file
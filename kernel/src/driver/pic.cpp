@@ -2,39 +2,107 @@
 
 #include "kernel/idt.hpp"
 #include "kernel/system.hpp"
+#include "kernel/trace.hpp"
 #include "driver/apic.hpp"
 
-inline irq_handler irq_routines[16];
+#define PIC_READ_ISR    0x0B    /* OCW3: the next command port read returns the in-service register */
+#define PIC_SPURIOUS    0x80    /* IRQ 7 of either PIC, which it raises for spurious interrupts */
+
+// How an interrupt on each vector is acknowledged
+enum IrqEoi : uint8_t {
+    EOI_NONE,       // exceptions, software interrupts and the APIC spurious vector
+    EOI_PIC_MASTER,
+    EOI_PIC_SLAVE,  // the slave and then the master it cascades through
+    EOI_APIC
+};
+
+static irq_handler vector_handlers[IRQ_VECTORS];
+static uint8_t vector_eoi[IRQ_VECTORS];
+static uint64_t vector_counts[IRQ_VECTORS];
+static volatile uint32_t irq_depth = 0;
+static regs* current_regs = nullptr;
 extern "C" void* irq_stub_table[];
 
 void irq_install_handler(const uint32_t irq, const irq_handler handler) {
-    irq_routines[irq] = handler;
+    vector_handlers[IRQ_VECTOR_BASE + irq] = handler;
 }
 
 void irq_uninstall_handler(const uint32_t irq) {
-    irq_routines[irq] = nullptr;
+    vector_handlers[IRQ_VECTOR_BASE + irq] = nullptr;
+}
+
+void irq_install_vector(const uint8_t vector, const irq_handler handler) {
+    vector_handlers[vector] = handler;
+}
+
+void irq_use_apic_eoi() {
+    for (uint32_t irq = 0; irq < IRQ_COUNT; irq++) vector_eoi[IRQ_VECTOR_BASE + irq] = EOI_APIC;
+}
+
+bool in_irq() {
+    return irq_depth != 0;
+}
+
+regs* irq_regs() {
+    return current_regs;
+}
+
+uint64_t irq_count(const uint32_t irq) {
+    return irq < IRQ_COUNT ? vector_counts[IRQ_VECTOR_BASE + irq] : 0;
+}
+
+uint64_t vector_count(const uint8_t vector) {
+    return vector_counts[vector];
 }
 
 static void io_wait() {
     outb(0x80, 0);
 }
 
+/**
+ * A PIC raises IRQ 7 when the line that requested an interrupt drops before
+ * it is acknowledged, without setting its in-service bit
+ */
+static bool pic_spurious(const uint16_t command) {
+    outb(command, PIC_READ_ISR);
+    return !(inb(command) & PIC_SPURIOUS);
+}
+
 extern "C" void irq_handle(regs* r) {
-    if (r->int_no == 255) {
-        // Spurious interrupt from APIC
+    const uint8_t vector = r->int_no;
+    const uint8_t eoi = vector_eoi[vector];
+
+    if (vector == IRQ_VECTOR_BASE + 7 && eoi == EOI_PIC_MASTER && pic_spurious(PIC1_COMMAND)) return;
+    if (vector == IRQ_VECTOR_BASE + 15 && eoi == EOI_PIC_SLAVE && pic_spurious(PIC2_COMMAND)) {
+        // The master still saw a real request on the cascade line
+        outb(PIC1_COMMAND, PIC_EOI);
         return;
     }
 
-    if (r->int_no >= 32 && r->int_no < 48) {
-        if (const irq_handler handler = irq_routines[r->int_no - 32]) {
-            handler(r);
-        }
+    vector_counts[vector]++;
+    if (const irq_handler handler = vector_handlers[vector]) {
+        regs* const outer = current_regs;
+        current_regs = r;
+        irq_depth = irq_depth + 1;
+        TRACE_BEGIN_ARG("irq", static_cast<uint32_t>(vector - IRQ_VECTOR_BASE));
+        handler(r);
+        TRACE_END("irq");
+        irq_depth = irq_depth - 1;
+        current_regs = outer;
     }
 
-    outb(PIC1_COMMAND, PIC_EOI); // send end of interrupt (EOI) signal
-
-    if (apic::is_enabled()) {
-        apic::eoi();
+    switch (eoi) {
+        case EOI_APIC:
+            apic::eoi();
+            break;
+        case EOI_PIC_SLAVE:
+            outb(PIC2_COMMAND, PIC_EOI);
+            [[fallthrough]];
+        case EOI_PIC_MASTER:
+            outb(PIC1_COMMAND, PIC_EOI);
+            break;
+        default:
+            break;
     }
 }
 
@@ -43,14 +111,25 @@ namespace pic {
         remap();
         unmask_irq(1); // unmask keyboard IRQ (IRQ1)
 
-        for (uint8_t i = 0; i < 16; i++) {
-            // Hardware interrupts start at vector 32
-            idt_set_gate(32 + i, reinterpret_cast<uint64_t>(irq_stub_table[i]), 0x8E);
+        for (uint32_t vector = IRQ_VECTOR_BASE; vector < IRQ_VECTORS; vector++) {
+            idt_set_gate(vector, reinterpret_cast<uint64_t>(irq_stub_table[vector - IRQ_VECTOR_BASE]), 0x8E);
         }
-        idt_set_gate(255, reinterpret_cast<uint64_t>(irq_stub_table[15]), 0x8E);
+
+        for (uint8_t irq = 0; irq < 16; irq++) {
+            vector_eoi[IRQ_VECTOR_BASE + irq] = irq < 8 ? EOI_PIC_MASTER : EOI_PIC_SLAVE;
+        }
+        // The local APIC timer, PMI and HPET can only come from the APICs
+        vector_eoi[IRQ_VECTOR_BASE + APIC_TIMER_IRQ] = EOI_APIC;
+        vector_eoi[IRQ_VECTOR_BASE + APIC_PMU_IRQ] = EOI_APIC;
+        vector_eoi[IRQ_VECTOR_BASE + APIC_HPET_IRQ] = EOI_APIC;
     }
 
     void unmask_irq(uint8_t irq) {
+        if (apic::is_enabled()) {
+            apic::unmask_irq(irq);
+            return;
+        }
+
         uint16_t port;
 
         if (irq < 8) {
@@ -64,6 +143,11 @@ namespace pic {
     }
 
     void mask_irq(uint8_t irq) {
+        if (apic::is_enabled()) {
+            apic::mask_irq(irq);
+            return;
+        }
+
         uint16_t port;
 
         if (irq < 8) {
@@ -0,0 +1,61 @@
+#include "driver/pm_timer.hpp"
+
+#include <uacpi/tables.h>
+
+#include "kernel/system.hpp"
+#include "lib/log.hpp"
+
+namespace pm_timer {
+    static uint16_t port = 0;
+    static uint32_t mask = 0;
+    static uint32_t last = 0;
+    static uint64_t elapsed = 0;
+
+    bool init() {
+        acpi_fadt* fadt;
+        if (uacpi_unlikely_error(uacpi_table_fadt(&fadt))) return false;
+
+        if (fadt->x_pm_tmr_blk.address && fadt->x_pm_tmr_blk.address_space_id == ACPI_AS_ID_SYS_IO) {
+            port = static_cast<uint16_t>(fadt->x_pm_tmr_blk.address);
+        } else if (fadt->pm_tmr_blk && fadt->pm_tmr_len == 4) {
+            port = static_cast<uint16_t>(fadt->pm_tmr_blk);
+        } else {
+            logger.warn("PM timer: not present in the FADT");
+            return false;
+        }
+
+        mask = (fadt->flags & ACPI_TMR_VAL_EXT) ? 0xFFFFFFFF : 0x00FFFFFF;
+        last = read();
+        elapsed = 0;
+
+        logger.info("PM timer: port 0x%x, %d bits", port, mask == 0xFFFFFFFF ? 32 : 24);
+        return true;
+    }
+
+    bool is_available() {
+        return port != 0;
+    }
+
+    uint32_t read() {
+        return inl(port) & mask;
+    }
+
+    uint32_t get_mask() {
+        return mask;
+    }
+
+    uint64_t now_ns() {
+        if (!port) return 0;
+
+        // Also called from IRQ handlers, which must not interleave with the update
+        const uint64_t flags = irq_save();
+        const uint32_t now = read();
+        elapsed += (now - last) & mask;
+        last = now;
+        const uint64_t ticks = elapsed;
+        irq_restore(flags);
+
+        return ticks / PM_TIMER_FREQUENCY * 1000000000ull
+             + ticks % PM_TIMER_FREQUENCY * 1000000000ull / PM_TIMER_FREQUENCY;
+    }
+}
@@ -0,0 +1,191 @@
+#include "driver/pmu.hpp"
+
+#include "driver/apic.hpp"
+#include "driver/pic.hpp"
+#include "lib/format.hpp"
+#include "lib/log.hpp"
+
+#define CPUID_PERFMON            0x0A
+
+#define IA32_PMC0                0x0C1
+#define IA32_PERFEVTSEL0         0x186
+#define IA32_PERF_GLOBAL_STATUS  0x38E
+#define IA32_PERF_GLOBAL_CTRL    0x38F
+#define IA32_PERF_GLOBAL_OVF_CTRL 0x390
+
+#define PERFEVTSEL_USR           (1 << 16)
+#define PERFEVTSEL_OS            (1 << 17)
+#define PERFEVTSEL_INT           (1 << 20)
+#define PERFEVTSEL_EN            (1 << 22)
+
+#define PMU_MAX_COUNTERS         8
+#define PMU_MAX_PERIOD           0x7FFFFFFF // counter writes sign-extend bit 31
+
+namespace pmu {
+    struct EventDef {
+        const char* name;
+        uint8_t event;
+        uint8_t umask;
+        uint8_t unavailable_bit; // set in CPUID.0AH:EBX when the CPU does not count it
+    };
+
+    // Architectural events, Intel SDM vol. 3B table 20-1
+    static constexpr EventDef events[PMU_EVENT_COUNT] = {
+        {"cycles", 0x3C, 0x00, 0},
+        {"instructions", 0xC0, 0x00, 1},
+        {"llc_misses", 0x2E, 0x41, 4},
+        {"branch_misses", 0xC5, 0x00, 6},
+    };
+
+    static bool available = false;
+    static uint8_t version = 0;
+    static uint8_t counter_count = 0;
+    static uint64_t counter_mask = 0; // counters are this many bits wide
+
+    static int8_t counter_of[PMU_EVENT_COUNT] = {-1, -1, -1, -1}; // -1 when the event is not counted
+    static uint8_t counters_used = 0;
+
+    static int8_t sample_counter = -1;
+    static uint64_t sample_period = 0;
+    static pmu_overflow_handler sample_handler = nullptr;
+
+    static uint64_t event_select(const PmuEvent event) {
+        return events[event].event | events[event].umask << 8 | PERFEVTSEL_USR | PERFEVTSEL_OS | PERFEVTSEL_EN;
+    }
+
+    static uint64_t rdpmc(const uint32_t counter) {
+        uint32_t lo, hi;
+        asm volatile("rdpmc" : "=a"(lo), "=d"(hi) : "c"(counter));
+        return static_cast<uint64_t>(hi) << 32 | lo;
+    }
+
+    static void set_global_enable() {
+        if (version < 2) return;
+
+        uint64_t mask = 0;
+        for (uint8_t i = 0; i < counters_used; i++) mask |= 1ull << i;
+        if (sample_counter >= 0) mask |= 1ull << sample_counter;
+        wrmsr(IA32_PERF_GLOBAL_CTRL, mask);
+    }
+
+    // Preload the counter so that it overflows after period more events
+    static void arm_sample_counter() {
+        wrmsr(IA32_PMC0 + sample_counter, (0 - sample_period) & counter_mask);
+    }
+
+    static void overflow_irq(regs* r) {
+        if (sample_counter < 0) return;
+
+        if (version >= 2) {
+            const uint64_t status = rdmsr(IA32_PERF_GLOBAL_STATUS);
+            if (!(status & (1ull << sample_counter))) return;
+            wrmsr(IA32_PERF_GLOBAL_OVF_CTRL, status);
+        }
+
+        arm_sample_counter();
+        if (sample_handler) sample_handler(r);
+        apic::set_pmu_interrupt(true);
+    }
+
+    bool init() {
+        uint32_t eax, ebx, ecx, edx;
+        cpuid(0, 0, eax, ebx, ecx, edx);
+        if (eax >= CPUID_PERFMON) {
+            cpuid(CPUID_PERFMON, 0, eax, ebx, ecx, edx);
+            version = eax & 0xFF;
+            counter_count = (eax >> 8) & 0xFF;
+            const uint8_t width = (eax >> 16) & 0xFF;
+            const uint8_t ebx_length = (eax >> 24) & 0xFF;
+
+            if (version > 0 && counter_count > 0 && width > 0) {
+                if (counter_count > PMU_MAX_COUNTERS) counter_count = PMU_MAX_COUNTERS;
+                counter_mask = width >= 64 ? ~0ull : (1ull << width) - 1;
+
+                for (uint8_t e = 0; e < PMU_EVENT_COUNT; e++) {
+                    counter_of[e] = -1;
+                    const uint8_t bit = events[e].unavailable_bit;
+                    if (bit >= ebx_length || ebx & (1u << bit) || counters_used == counter_count) continue;
+
+                    counter_of[e] = counters_used;
+                    wrmsr(IA32_PERFEVTSEL0 + counters_used, 0);
+                    wrmsr(IA32_PMC0 + counters_used, 0);
+                    wrmsr(IA32_PERFEVTSEL0 + counters_used, event_select(static_cast<PmuEvent>(e)));
+                    counters_used++;
+                }
+                available = counters_used > 0;
+            }
+        }
+
+        if (!available) {
+            logger.info("PMU: no architectural performance counters, timing with the TSC only");
+            return false;
+        }
+
+        set_global_enable();
+
+        StackString<64> counting;
+        for (uint8_t e = 0; e < PMU_EVENT_COUNT; e++) {
+            if (counter_of[e] >= 0) counting.append("%s%s", counting.size() ? ", " : "", events[e].name);
+        }
+        logger.info(
+            "PMU: version %u, %u counters of %u bits, counting %s",
+            version,
+            counter_count,
+            static_cast<uint32_t>(64 - __builtin_clzll(counter_mask)),
+            counting.c_str()
+        );
+        return true;
+    }
+
+    bool is_available() {
+        return available;
+    }
+
+    bool has_event(const PmuEvent event) {
+        return event < PMU_EVENT_COUNT && counter_of[event] >= 0;
+    }
+
+    const char* event_name(const PmuEvent event) {
+        return event < PMU_EVENT_COUNT ? events[event].name : "?";
+    }
+
+    void read(PmuCounts& counts) {
+        for (uint8_t e = 0; e < PMU_EVENT_COUNT; e++) {
+            counts.values[e] = counter_of[e] >= 0 ? rdpmc(counter_of[e]) & counter_mask : 0;
+        }
+    }
+
+    bool start_sampling(const PmuEvent event, const uint64_t period, const pmu_overflow_handler handler) {
+        if (!available || counters_used == counter_count || event >= PMU_EVENT_COUNT || period == 0) return false;
+        if (!has_event(event) || period > PMU_MAX_PERIOD) return false;
+
+        sample_counter = counters_used;
+        sample_period = period;
+        sample_handler = handler;
+
+        irq_install_handler(APIC_PMU_IRQ, overflow_irq);
+        if (!apic::set_pmu_interrupt(true)) {
+            irq_uninstall_handler(APIC_PMU_IRQ);
+            sample_counter = -1;
+            return false;
+        }
+
+        wrmsr(IA32_PERFEVTSEL0 + sample_counter, 0);
+        arm_sample_counter();
+        wrmsr(IA32_PERFEVTSEL0 + sample_counter, event_select(event) | PERFEVTSEL_INT);
+        set_global_enable();
+
+        logger.info(FMT("PMU: sampling every %u %s"), period, event_name(event));
+        return true;
+    }
+
+    void stop_sampling() {
+        if (sample_counter < 0) return;
+
+        wrmsr(IA32_PERFEVTSEL0 + sample_counter, 0);
+        apic::set_pmu_interrupt(false);
+        irq_uninstall_handler(APIC_PMU_IRQ);
+        sample_counter = -1;
+        set_global_enable();
+    }
+}
@@ -1,72 +1,77 @@
-#include <cstddef>
 #include "driver/ps2/keyboard.hpp"
+#include "kernel/event.hpp"
 #include "kernel/system.hpp"
+#include "lib/log.hpp"
 #include "driver/pic.hpp"
 #include "driver/ps2/ps2.hpp"
+#include "driver/tsc.hpp"
 
-#define KB_BUFFER_SIZE  64
+#define KB_CMD_TYPEMATIC    0xF3
+#define KB_TYPEMATIC_SLOW   0x7F // 1000 ms delay, 2 repeats per second
 
-static key_listener_t g_listener = nullptr;
+// Prefix bytes seen since the last complete scancode
+static bool break_key = false;
+static bool ext_key = false;
+// Arrival of the first byte of the scancode being decoded, 0 if none
+static uint64_t first_byte_ns = 0;
 
-static volatile uint8_t kb_buf[KB_BUFFER_SIZE];
-static volatile uint8_t kb_buf_head = 0;
-static volatile uint8_t kb_buf_tail = 0;
+// One bit per scancode, for normal and extended keys
+static volatile uint64_t pressed[2][4];
 
-static void kb_enqueue(const uint8_t scancode) {
-    if (const size_t next = (kb_buf_head + 1) % sizeof(kb_buf); next != kb_buf_tail) {
-        kb_buf[next] = scancode;
-        kb_buf_head = next;
-    }
-}
-
-static bool kb_dequeue(uint8_t* out) {
-    if (kb_buf_tail == kb_buf_head) return false;
-    *out = kb_buf[kb_buf_tail];
-    kb_buf_tail = (kb_buf_tail + 1) % sizeof(kb_buf);
-    return true;
+bool kb_is_pressed(const uint8_t scancode, const bool extended) {
+    return pressed[extended][scancode / 64] & (1ull << (scancode % 64));
 }
 
-void kb_register_listener(const key_listener_t listener) {
-    g_listener = listener;
-}
+void kb_handler([[maybe_unused]] regs* r) {
+    const uint64_t now = tsc::now_ns();
+    const uint8_t sc = inb(PS2_DATA_PORT);
 
-void kb_unregister_listener() { g_listener = nullptr; }
+    if (sc == PS2_ACK) return;
 
-bool break_key = false;
-bool ext_key = false;
+    if (!first_byte_ns) first_byte_ns = now;
 
-void kb_process_queue() {
-    uint8_t sc;
-    while (kb_dequeue(&sc)) {
-        if (sc == 0xE0) {
-            ext_key = true;
-            continue;
-        }
+    if (sc == 0xE0) {
+        ext_key = true;
+        return;
+    }
 
-        if (sc == 0xF0) {
-            break_key = true;
-            continue;
-        }
+    if (sc == 0xF0) {
+        break_key = true;
+        return;
+    }
 
-        const KeyEvent ev = {
-            .scancode = sc,
-            .break_key = break_key,
-            .extended_key = ext_key
-        };
+    const bool was_pressed = kb_is_pressed(sc, ext_key);
+    const uint64_t bit = 1ull << (sc % 64);
+    if (break_key) {
+        pressed[ext_key][sc / 64] &= ~bit;
+    } else {
+        pressed[ext_key][sc / 64] |= bit;
+    }
 
-        break_key = false;
-        ext_key = false;
+    Event ev = {};
+    ev.type = EVENT_KEY;
+    ev.key = {
+        .scancode = sc,
+        .break_key = break_key,
+        .extended_key = ext_key,
+        .timestamp = first_byte_ns
+    };
 
-        if (g_listener) g_listener(ev);
-    }
-}
+    break_key = false;
+    ext_key = false;
+    first_byte_ns = 0;
 
-void kb_handler([[maybe_unused]] regs* r) {
-    const unsigned char scancode = inb(PS2_DATA_PORT);
+    // Typematic repeat of a key that is already down
+    if (!ev.key.break_key && was_pressed) return;
 
-    kb_enqueue(scancode);
+    events::post(ev);
 }
 
 void kb_init() {
+    // Done before the handler is installed so the ACKs are not taken for scancodes
+    if (!ps2::send(KB_CMD_TYPEMATIC) || !ps2::send(KB_TYPEMATIC_SLOW)) {
+        logger.warn("Keyboard: failed to set the typematic rate");
+    }
+
     irq_install_handler(1, kb_handler);
 }
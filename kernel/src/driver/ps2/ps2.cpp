@@ -1,30 +1,62 @@
 #include "driver/ps2/ps2.hpp"
 #include "kernel/system.hpp"
+#include "lib/log.hpp"
 
 namespace ps2 {
-    void wait_input_clear() {
-        while (inb(PS2_STATUS_PORT) & 0x02);
+    static bool wait_input_clear() {
+        for (uint32_t timeout = PS2_TIMEOUT_SPINS; timeout > 0; timeout--) {
+            if (!(inb(PS2_STATUS_PORT) & 0x02)) return true;
+            asm volatile("pause");
+        }
+        return false;
+    }
+
+    static bool wait_output_full() {
+        for (uint32_t timeout = PS2_TIMEOUT_SPINS; timeout > 0; timeout--) {
+            if (inb(PS2_STATUS_PORT) & 0x01) return true;
+            asm volatile("pause");
+        }
+        return false;
+    }
+
+    static bool write_command(const uint8_t command) {
+        if (!wait_input_clear()) return false;
+        outb(PS2_COMMAND_PORT, command);
+        return true;
     }
 
-    void wait_output_full() {
-        while (!(inb(PS2_STATUS_PORT) & 0x01));
+    static bool write_data(const uint8_t byte) {
+        if (!wait_input_clear()) return false;
+        outb(PS2_DATA_PORT, byte);
+        return true;
     }
 
-    void init() {
+    static bool read_data(uint8_t& byte) {
+        if (!wait_output_full()) return false;
+        byte = inb(PS2_DATA_PORT);
+        return true;
+    }
+
+    bool send(const uint8_t byte) {
+        if (!write_data(byte)) return false;
+
+        uint8_t reply;
+        return read_data(reply) && reply == PS2_ACK;
+    }
+
+    bool init() {
+        // A missing controller reads as all ones
+        if (inb(PS2_STATUS_PORT) == 0xFF) return false;
+
         // Disable both ports
-        wait_input_clear();
-        outb(PS2_COMMAND_PORT, 0xAD);
-        wait_input_clear();
-        outb(PS2_COMMAND_PORT, 0xA7);
+        if (!write_command(0xAD) || !write_command(0xA7)) return false;
 
         // Flush output buffer
-        while (inb(PS2_STATUS_PORT) & 1) inb(PS2_DATA_PORT);
+        for (uint32_t i = 0; i < PS2_TIMEOUT_SPINS && inb(PS2_STATUS_PORT) & 1; i++) inb(PS2_DATA_PORT);
 
         // Get config byte
-        wait_input_clear();
-        outb(PS2_COMMAND_PORT, 0x20);
-        wait_output_full();
-        uint8_t config = inb(PS2_DATA_PORT);
+        uint8_t config;
+        if (!write_command(0x20) || !read_data(config)) return false;
 
         // Modify config byte
         config |= 0x01;   // Enable first port interrupt
@@ -32,22 +64,18 @@ namespace ps2 {
         config &= ~0x40;  // Disable translation
         config &= ~0x88;  // Clear bits 3 and 7
         // Write config
-        wait_input_clear();
-        outb(PS2_COMMAND_PORT, 0x60);
-        wait_input_clear();
-        outb(PS2_DATA_PORT, config);
+        if (!write_command(0x60) || !write_data(config)) return false;
 
         // Controller self-test
-        wait_input_clear();
-        outb(PS2_COMMAND_PORT, 0xAA);
-        wait_output_full();
-        if (const uint8_t res = inb(PS2_DATA_PORT); res != 0x55) {
-            panic("PS/2 Controller test fail! 0x%x", res);
+        uint8_t res;
+        if (!write_command(0xAA) || !read_data(res)) return false;
+        if (res != 0x55) {
+            logger.error("PS/2: controller self-test failed with 0x%x", res);
+            return false;
         }
 
         // Enable port
-        wait_input_clear();
-        outb(PS2_COMMAND_PORT, 0xAE);
+        if (!write_command(0xAE)) return false;
 
         // Reset keyboard
         // wait_input_clear();
@@ -57,10 +85,8 @@ namespace ps2 {
         // wait_output_full();
         // inb(PS2_DATA_PORT);
 
-        // Enable scanning
-        wait_input_clear();
-        outb(PS2_DATA_PORT, 0xF4);
-        wait_output_full();
-        inb(PS2_DATA_PORT);
+        // Enable scanning, a keyboard that is not plugged in yet just doesn't answer
+        if (!send(0xF4)) logger.warn("PS/2: keyboard did not acknowledge enable scanning");
+        return true;
     }
 }
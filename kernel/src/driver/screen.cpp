@@ -1,5 +1,8 @@
 #include "driver/screen.hpp"
 #include "driver/limine/limine.h"
+#include "kernel/frame_stats.hpp"
+#include "kernel/latency.hpp"
+#include "kernel/trace.hpp"
 #include "lib/font8x8.hpp"
 #include "memory/mem.hpp"
 #include "lib/log.hpp"
@@ -149,6 +152,10 @@ namespace screen {
     }
 
     void flush() {
+        TRACE_BEGIN("screen::flush");
         memcpy_fast(framebuffer.addr, vga_buffer, framebuffer.size);
+        TRACE_END("screen::flush");
+        latency::frame_presented();
+        frame_stats::frame_presented();
     }
 }
@@ -1,14 +1,43 @@
 #include "driver/serial.hpp"
+#include "driver/pic.hpp"
+#include "driver/tsc.hpp"
+#include "kernel/event.hpp"
 #include "kernel/system.hpp"
 #include "lib/format.hpp"
+#include "lib/ring.hpp"
+#include "lib/string.hpp"
+
+#define SERIAL_CLOCK        115200 // divisor 1
+#define SERIAL_FIFO_SIZE    16
+
+#define REG_DATA    0
+#define REG_IER     1
+#define REG_IIR     2
+#define REG_LCR     3
+#define REG_LSR     5
+#define REG_MSR     6
+
+#define IER_RX      0x01 // received data available
+#define IER_THRE    0x02 // transmit holding register empty
+
+#define LSR_DATA    0x01
+#define LSR_THRE    0x20
+#define LSR_TEMT    0x40
 
 namespace serial {
     static bool s_available = false;
 
+    // Bytes waiting for the transmitter. Any context may write, while only the
+    // interrupt handler or a writer with interrupts disabled drains it, so on
+    // one CPU there is never more than one consumer at a time.
+    static MpscRing<char, SERIAL_TX_BUFFER_SIZE> tx_ring;
+    static bool tx_irq = false;    // writes go through tx_ring
+    static uint8_t ier = 0;        // shadow of the interrupt enable register
+
     int init() {
         outb(PORT + 1, 0x00); // Disable all interrupts
         outb(PORT + 3, 0x80); // Enable DLAB (set baud rate divisor)
-        outb(PORT + 0, 0x03); // Set divisor to 3 (lo byte) 38400 baud
+        outb(PORT + 0, 0x03); // Set divisor to 3 (lo byte) 38400 baud, see set_baud()
         outb(PORT + 1, 0x00); //                  (hi byte)
         outb(PORT + 3, 0x03); // 8 bits, no parity, one stop bit
         outb(PORT + 2, 0xC7); // Enable FIFO, clear them, with 14-byte threshold
@@ -28,8 +57,124 @@ namespace serial {
         return 0;
     }
 
+    static void write_sync(const char c) {
+        int timeout = 10000;
+        while (timeout-- > 0 && !transmitted()) {
+            asm volatile ("pause");
+        }
+        outb(PORT, c);
+    }
+
+    /**
+     * Move up to a FIFO's worth of queued bytes into the transmitter if it is
+     * empty. Called with interrupts disabled.
+     * @return false if nothing was queued
+     */
+    static bool tx_fill() {
+        if (!transmitted()) return true;
+
+        char burst[SERIAL_FIFO_SIZE];
+        const uint32_t n = tx_ring.pop_batch(burst, SERIAL_FIFO_SIZE);
+        for (uint32_t i = 0; i < n; i++) outb(PORT + REG_DATA, burst[i]);
+        return n > 0;
+    }
+
+    static void set_ier(const uint8_t value) {
+        ier = value;
+        outb(PORT + REG_IER, ier);
+    }
+
+    /**
+     * Start the transmitter after queueing bytes, unless it is already running
+     */
+    static void tx_kick() {
+        const uint64_t flags = irq_save();
+        if (!(ier & IER_THRE) && tx_fill()) set_ier(ier | IER_THRE);
+        irq_restore(flags);
+    }
+
+    static void irq_handler([[maybe_unused]] regs* r) {
+        const uint64_t now = tsc::now_ns();
+
+        // Bounded in case the UART keeps reporting a cause that is never cleared
+        for (uint8_t i = 0; i < 8; i++) {
+            const uint8_t iir = inb(PORT + REG_IIR);
+            if (iir & 0x01) break; // nothing pending
+
+            switch (iir & 0x0E) {
+                case 0x04: // received data
+                case 0x0C: // character timeout
+                    // Reading RBR clears the interrupt
+                    while (received()) {
+                        Event ev = {};
+                        ev.type = EVENT_SERIAL;
+                        ev.serial = {static_cast<char>(inb(PORT + REG_DATA)), now};
+                        events::post(ev);
+                    }
+                    break;
+
+                case 0x02: // transmitter empty, reading IIR cleared it
+                    if (!tx_fill()) set_ier(ier & ~IER_THRE);
+                    break;
+
+                case 0x06: // line status
+                    inb(PORT + REG_LSR);
+                    break;
+
+                default: // modem status
+                    inb(PORT + REG_MSR);
+                    break;
+            }
+        }
+    }
+
+    void enable_irq() {
+        if (!s_available) return;
+
+        irq_install_handler(SERIAL_IRQ, irq_handler);
+        const uint64_t flags = irq_save();
+        set_ier(IER_RX);
+        tx_irq = true;
+        irq_restore(flags);
+        pic::unmask_irq(SERIAL_IRQ);
+    }
+
+    void sync() {
+        const uint64_t flags = irq_save();
+        tx_irq = false;
+        set_ier(ier & ~IER_THRE);
+
+        char c;
+        while (tx_ring.pop(c)) write_sync(c);
+        irq_restore(flags);
+    }
+
+    bool set_baud(const uint32_t baud) {
+        if (baud == 0 || baud > SERIAL_CLOCK || SERIAL_CLOCK % baud != 0) return false;
+        const uint16_t divisor = SERIAL_CLOCK / baud;
+
+        const uint64_t flags = irq_save();
+
+        // Let everything queued go out at the old rate first
+        char c;
+        while (tx_ring.pop(c)) write_sync(c);
+        for (int timeout = 100000; timeout > 0 && !(inb(PORT + REG_LSR) & LSR_TEMT); timeout--) {
+            asm volatile ("pause");
+        }
+
+        const uint8_t lcr = inb(PORT + REG_LCR);
+        outb(PORT + REG_LCR, lcr | 0x80); // DLAB
+        outb(PORT + 0, divisor & 0xFF);
+        outb(PORT + 1, divisor >> 8);
+        outb(PORT + REG_LCR, lcr);
+        outb(PORT + REG_IER, ier); // the divisor high byte shares the IER port
+
+        irq_restore(flags);
+        return true;
+    }
+
     bool received() {
-        return inb(PORT + 5) & 1;
+        return inb(PORT + REG_LSR) & LSR_DATA;
     }
 
     char read() {
@@ -39,29 +184,74 @@ namespace serial {
     }
 
     bool transmitted() {
-        return inb(PORT + 5) & 0x20;
+        return inb(PORT + REG_LSR) & LSR_THRE;
     }
 
-    void putchar(const char c) {
+    size_t tx_space() {
+        return tx_irq ? SERIAL_TX_BUFFER_SIZE - tx_ring.size() : SERIAL_TX_BUFFER_SIZE;
+    }
+
+    void write(const char* data, size_t len) {
         if (!s_available) return;
-        int timeout = 10000;
-        while (timeout-- > 0 && !transmitted()) {
-            asm volatile ("pause");
+
+        if (!tx_irq) {
+            for (size_t i = 0; i < len; i++) write_sync(data[i]);
+            return;
         }
-        outb(PORT, c);
+
+        while (len) {
+            const uint32_t chunk = len < SERIAL_TX_BUFFER_SIZE ? len : SERIAL_TX_BUFFER_SIZE;
+            const uint32_t n = tx_ring.push_batch(data, chunk);
+            data += n;
+            len -= n;
+            if (!len) break;
+
+            // Writing faster than the line rate: drain some of the ring synchronously
+            const uint64_t flags = irq_save();
+            char burst[SERIAL_FIFO_SIZE];
+            const uint32_t drained = tx_ring.pop_batch(burst, SERIAL_FIFO_SIZE);
+            for (uint32_t i = 0; i < drained; i++) write_sync(burst[i]);
+            irq_restore(flags);
+        }
+
+        tx_kick();
+    }
+
+    void putchar(const char c) {
+        write(&c, 1);
     }
 
     void print(const char* str) {
         if (!str) return;
-        while (*str) {
-            putchar(*str++);
+        write(str, strlen(str));
+    }
+
+    static void sink_write(void*, const char* data, const size_t len) {
+        write(data, len);
+    }
+
+    void write_hex(const void* data, const size_t len) {
+        static constexpr char hex[] = "0123456789abcdef";
+        const auto bytes = static_cast<const uint8_t*>(data);
+        char line[SERIAL_HEX_LINE_BYTES * 2 + 1];
+
+        for (size_t start = 0; start < len; start += SERIAL_HEX_LINE_BYTES) {
+            const size_t n = len - start < SERIAL_HEX_LINE_BYTES ? len - start : SERIAL_HEX_LINE_BYTES;
+            for (size_t i = 0; i < n; i++) {
+                line[i * 2] = hex[bytes[start + i] >> 4];
+                line[i * 2 + 1] = hex[bytes[start + i] & 0xF];
+            }
+            line[n * 2] = '\n';
+            write(line, n * 2 + 1);
         }
     }
 
     void printf(const char* fmt, ...) {
+        // Stream straight into the transmit ring instead of building a string
+        static constexpr FormatSink sink = {sink_write, nullptr};
         va_list ap;
         va_start(ap, fmt);
-        print(vformat(fmt, ap));
+        vformat_to(sink, fmt, ap);
         va_end(ap);
     }
 
@@ -1,9 +1,11 @@
 #include "driver/sound.hpp"
 #include "driver/timer.hpp"
 #include "kernel/system.hpp"
+#include "kernel/timer_wheel.hpp"
 
-static bool beep_active = false;
-static uint32_t beep_end_tick = 0;
+#define BEEP_MS 100
+
+static Timer beep_timer;
 
 void snd_play(const uint32_t frequency) {
     const uint32_t div = PIT_FREQUENCY / frequency;
@@ -22,17 +24,14 @@ void snd_stop() {
     outb(0x61, tmp);
 }
 
-void beep() {
-    if (!beep_active) {
-        snd_play(300);
-        beep_active = true;
-        beep_end_tick = timer::timer_ticks + 10;
-    }
+static void beep_end(void*) {
+    snd_stop();
 }
 
-void snd_tick() {
-    if (beep_active && timer::timer_ticks >= beep_end_tick) {
-        snd_stop();
-        beep_active = false;
-    }
+void beep() {
+    if (beep_timer.pending) return;
+
+    snd_play(300);
+    timer_wheel::setup(beep_timer, beep_end, nullptr, false);
+    timer_wheel::add(beep_timer, BEEP_MS);
 }
@@ -1,19 +1,64 @@
 #include "driver/timer.hpp"
 
+#include "driver/apic.hpp"
+#include "driver/hpet.hpp"
 #include "driver/pic.hpp"
 #include "driver/screen.hpp"
-#include "driver/sound.hpp"
+#include "driver/tsc.hpp"
 #include "kernel/system.hpp"
+#include "kernel/timer_wheel.hpp"
 
 #define PIT_CHANNEL_0   0x40
 #define PIT_CHANNEL_1   0x41
 #define PIT_CMD         0x43
 
 namespace timer {
+    static uint32_t tick_frequency = 0;
+    static bool tickless = false;
+    // Deadline of the sleep_until() in progress, if any
+    static uint64_t wake_deadline = UINT64_MAX;
+    // Set when the handler ends that sleep, which the HPET may do while it is being armed
+    static volatile bool wake_fired = false;
+
+    static uint64_t now_ms() {
+        return tsc::now_ns() / 1000000;
+    }
+
+    /**
+     * Arm the APIC timer, or the HPET without one, for whichever comes first,
+     * the sleep deadline or the next timer on the wheel. Called with
+     * interrupts disabled.
+     */
+    static void arm_next() {
+        uint64_t deadline = wake_deadline;
+        const uint64_t next = timer_wheel::next_expiry();
+        if (next != TIMER_WHEEL_NONE && next * 1000000 < deadline) deadline = next * 1000000;
+        if (deadline == UINT64_MAX) return;
+
+        if (apic::has_timer()) {
+            apic::set_deadline(deadline);
+        } else if (tickless) {
+            const uint64_t now = tsc::now_ns();
+            hpet::arm_oneshot(deadline > now ? deadline - now : 0);
+        }
+    }
+
     void timer_handler(regs* r) {
+        (void)r;
         timer_ticks++;
+        timer_wheel::advance(now_ms());
+    }
 
-        snd_tick();
+    static void deadline_handler(regs* r) {
+        (void)r;
+        // The sleep this ends is over, and re-arming for a deadline already
+        // due would fire again as soon as interrupts are back on
+        if (wake_deadline <= tsc::now_ns()) {
+            wake_deadline = UINT64_MAX;
+            wake_fired = true;
+        }
+        timer_wheel::advance(now_ms());
+        arm_next();
     }
 
     void init(const uint32_t frequency) {
@@ -26,6 +71,7 @@ namespace timer {
         // PIT frequency = 1193182 Hz
         // Divisor for 100Hz = 1193182 / 100 = 11931 (0x2E9B)
         const uint32_t divisor = PIT_FREQUENCY / frequency;
+        tick_frequency = frequency;
 
         outb(PIT_CMD, 0x36);
         outb(PIT_CHANNEL_0, divisor & 0xFF);
@@ -37,6 +83,12 @@ namespace timer {
      * @param ticks
      */
     void wait(const uint32_t ticks) {
+        if (tickless) {
+            const uint64_t deadline = tsc::now_ns() + static_cast<uint64_t>(ticks) * (1000000000ull / tick_frequency);
+            while (tsc::now_ns() < deadline) sleep_until(deadline);
+            return;
+        }
+
         const uint32_t eticks = static_cast<uint32_t>(timer_ticks) + ticks;
         while (static_cast<int32_t>(eticks - static_cast<uint32_t>(timer_ticks)) > 0) {
             // halt until the next interrupt
@@ -45,6 +97,56 @@ namespace timer {
     }
 
     void wait_ms(const uint32_t ms) {
-        wait(ms / 10);
+        wait((static_cast<uint64_t>(ms) * tick_frequency + 999) / 1000);
+    }
+
+    uint32_t get_frequency() {
+        return tick_frequency;
+    }
+
+    uint64_t get_ticks() {
+        if (tickless) return tsc::now_ns() / (1000000000ull / tick_frequency);
+        return timer_ticks;
+    }
+
+    void sleep_until(const uint64_t deadline_ns) {
+        // Interrupts stay off between the check and hlt, so a wakeup can't be missed
+        asm volatile("cli");
+        if (tsc::now_ns() >= deadline_ns) {
+            asm volatile("sti");
+            return;
+        }
+
+        wake_deadline = deadline_ns;
+        wake_fired = false;
+        arm_next();
+        if (wake_fired) {
+            // The HPET found it already due and ran the handler while arming
+            asm volatile("sti");
+            return;
+        }
+        asm volatile("sti; hlt" ::: "memory");
+        wake_deadline = UINT64_MAX;
+    }
+
+    static void hpet_deadline() {
+        deadline_handler(nullptr);
+    }
+
+    void stop_tick() {
+        // Without the TSC, tsc::now_ns() counts these very ticks
+        if (tsc::get_frequency() == 0) return;
+
+        if (apic::has_timer()) {
+            irq_install_handler(APIC_TIMER_IRQ, deadline_handler);
+        } else if (!hpet::start_oneshot(hpet_deadline)) {
+            return;
+        }
+        pic::mask_irq(0);
+        tickless = true;
+
+        const uint64_t flags = irq_save();
+        arm_next();
+        irq_restore(flags);
     }
 }
\ No newline at end of file
@@ -0,0 +1,202 @@
+#include "driver/tsc.hpp"
+
+#include "driver/hpet.hpp"
+#include "driver/pm_timer.hpp"
+#include "driver/timer.hpp"
+#include "kernel/system.hpp"
+#include "lib/log.hpp"
+
+#define PIT_CHANNEL_2       0x42
+#define PIT_CMD             0x43
+#define PIT_GATE_PORT       0x61
+#define PIT_GATE_ENABLE     0x01
+#define PIT_SPEAKER_ENABLE  0x02
+#define PIT_OUT2            0x20
+
+#define CALIBRATE_MS        50
+#define CALIBRATE_ROUNDS    3
+// Give up on a reference clock that has not covered CALIBRATE_MS by now,
+// 20 times CALIBRATE_MS at 10 GHz and longer at any slower TSC
+#define CALIBRATE_TIMEOUT_CYCLES 10000000000ull
+
+#define CPUID_BASE_MAX      0x00000000
+#define CPUID_FEATURES      0x00000001
+#define CPUID_TSC_CRYSTAL   0x00000015
+#define CPUID_HV_BASE       0x40000000
+#define CPUID_HV_TIMING     0x40000010
+#define CPUID_EXT_MAX       0x80000000
+#define CPUID_EXT_POWER     0x80000007
+#define CPUID_INVARIANT_TSC (1 << 8)
+#define CPUID_HYPERVISOR    (1u << 31)
+
+namespace tsc {
+    static bool invariant = false;
+    static uint64_t frequency = 0;
+    static uint64_t base_cycles = 0;
+    // ns = cycles * ns_mult >> 32, cycles = ns * cycles_mult >> 24
+    static uint64_t ns_mult = 0;
+    static uint64_t cycles_mult = 0;
+
+    /**
+     * Count TSC cycles while PIT channel 2 counts down CALIBRATE_MS in mode 0
+     * @return TSC frequency in Hz, 0 if channel 2 never reached terminal count
+     */
+    static uint64_t measure_pit() {
+        constexpr uint16_t count = PIT_FREQUENCY * CALIBRATE_MS / 1000;
+
+        // Gate channel 2 on with the speaker output disconnected
+        const uint8_t gate = inb(PIT_GATE_PORT);
+        outb(PIT_GATE_PORT, (gate & ~PIT_SPEAKER_ENABLE) | PIT_GATE_ENABLE);
+
+        // Channel 2, lobyte/hibyte, mode 0 (interrupt on terminal count)
+        outb(PIT_CMD, 0xB0);
+        outb(PIT_CHANNEL_2, count & 0xFF);
+        outb(PIT_CHANNEL_2, count >> 8);
+
+        const uint64_t start = rdtsc();
+        uint64_t end = start;
+        while (!(inb(PIT_GATE_PORT) & PIT_OUT2)) {
+            end = rdtsc();
+            if (end - start > CALIBRATE_TIMEOUT_CYCLES) break;
+        }
+
+        outb(PIT_GATE_PORT, gate);
+        if (end - start > CALIBRATE_TIMEOUT_CYCLES) return 0;
+        return (end - start) * 1000 / CALIBRATE_MS;
+    }
+
+    /**
+     * Count TSC cycles over CALIBRATE_MS of another clocksource
+     * @return TSC frequency in Hz, 0 if the clock did not advance
+     */
+    static uint64_t measure_clock(uint64_t (*clock_ns)()) {
+        const uint64_t start_ns = clock_ns();
+        const uint64_t start = rdtsc();
+
+        uint64_t end_ns;
+        do {
+            end_ns = clock_ns();
+            if (rdtsc() - start > CALIBRATE_TIMEOUT_CYCLES) return 0;
+        } while (end_ns - start_ns < CALIBRATE_MS * 1000000ull);
+        const uint64_t end = rdtsc();
+
+        return (end - start) * 1000000000ull / (end_ns - start_ns);
+    }
+
+    /**
+     * The TSC frequency the CPU or the hypervisor states, which saves the
+     * CALIBRATE_ROUNDS * CALIBRATE_MS of measuring it at boot
+     * @return the frequency in Hz, 0 if neither does
+     */
+    static uint64_t enumerated_frequency(const char*& source) {
+        uint32_t eax, ebx, ecx, edx;
+        cpuid(CPUID_BASE_MAX, 0, eax, ebx, ecx, edx);
+        if (eax >= CPUID_TSC_CRYSTAL) {
+            // TSC = crystal clock * ebx / eax, where the crystal is stated at all
+            cpuid(CPUID_TSC_CRYSTAL, 0, eax, ebx, ecx, edx);
+            if (eax && ebx && ecx) {
+                source = "from CPUID";
+                return static_cast<uint64_t>(ecx) * ebx / eax;
+            }
+        }
+
+        // KVM and VMware report it in kHz in the generic timing leaf
+        cpuid(CPUID_FEATURES, 0, eax, ebx, ecx, edx);
+        if (ecx & CPUID_HYPERVISOR) {
+            cpuid(CPUID_HV_BASE, 0, eax, ebx, ecx, edx);
+            if (eax >= CPUID_HV_TIMING) {
+                cpuid(CPUID_HV_TIMING, 0, eax, ebx, ecx, edx);
+                if (eax) {
+                    source = "from the hypervisor";
+                    return static_cast<uint64_t>(eax) * 1000;
+                }
+            }
+        }
+
+        return 0;
+    }
+
+    /**
+     * Measure the TSC against the best clock available
+     * @return the frequency in Hz, 0 if the measurement failed
+     */
+    static uint64_t calibrate(const char*& source) {
+        // Prefer the HPET, then the ACPI PM timer, over PIT channel 2
+        source = "against the PIT";
+        uint64_t (*clock_ns)() = nullptr;
+        if (hpet::is_available()) {
+            source = "against the HPET";
+            clock_ns = hpet::now_ns;
+        } else if (pm_timer::is_available()) {
+            source = "against the PM timer";
+            clock_ns = pm_timer::now_ns;
+        }
+
+        // Take the median of a few rounds, as SMIs or the host can disturb any one of them
+        uint64_t rounds[CALIBRATE_ROUNDS];
+        for (uint8_t i = 0; i < CALIBRATE_ROUNDS; i++) {
+            const uint64_t hz = clock_ns ? measure_clock(clock_ns) : measure_pit();
+            if (hz == 0) return 0; // a dead clock would only time out again
+            uint8_t j = i;
+            for (; j > 0 && rounds[j - 1] > hz; j--) rounds[j] = rounds[j - 1];
+            rounds[j] = hz;
+        }
+        return rounds[CALIBRATE_ROUNDS / 2];
+    }
+
+    bool init() {
+        uint32_t eax, ebx, ecx, edx;
+        cpuid(CPUID_EXT_MAX, 0, eax, ebx, ecx, edx);
+        if (eax >= CPUID_EXT_POWER) {
+            cpuid(CPUID_EXT_POWER, 0, eax, ebx, ecx, edx);
+            invariant = edx & CPUID_INVARIANT_TSC;
+        }
+
+        // A stated frequency only describes a TSC that does not vary
+        const char* source = nullptr;
+        uint64_t hz = invariant ? enumerated_frequency(source) : 0;
+        if (hz == 0) hz = calibrate(source);
+
+        if (hz == 0) {
+            logger.warn("TSC: calibration failed, falling back to the PIT");
+            return false;
+        }
+
+        frequency = hz;
+        ns_mult = (1000000000ull << 32) / frequency;
+        cycles_mult = (frequency << 24) / 1000000000ull;
+        base_cycles = rdtsc();
+
+        logger.info(FMT("TSC: %u kHz %s%s"), frequency / 1000, source, invariant ? ", invariant" : "");
+        if (!invariant) logger.warn("TSC: not invariant, timings may drift with CPU frequency");
+        return true;
+    }
+
+    bool is_invariant() {
+        return invariant;
+    }
+
+    uint64_t get_frequency() {
+        return frequency;
+    }
+
+    uint64_t now_cycles() {
+        return rdtsc();
+    }
+
+    uint64_t cycles_to_ns(const uint64_t cycles) {
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(cycles) * ns_mult) >> 32);
+    }
+
+    uint64_t ns_to_cycles(const uint64_t ns) {
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(ns) * cycles_mult) >> 24);
+    }
+
+    uint64_t now_ns() {
+        if (frequency == 0) {
+            const uint32_t tick_hz = timer::get_frequency();
+            return tick_hz ? timer::get_ticks() * (1000000000ull / tick_hz) : 0;
+        }
+        return cycles_to_ns(rdtsc() - base_cycles);
+    }
+}
@@ -0,0 +1,243 @@
+#include "tetris/ai.hpp"
+
+// Board rows are kept as bitmasks with the playfield in bits 3..12 and the
+// walls set around it, so a piece row collides iff (row & piece_mask) != 0
+#define WALL_OFFSET 3
+#define ROW_WALLS   0xFFFFE007u
+#define ROW_FULL    0x00001FF8u
+
+struct Bitboard {
+    uint32_t rows[TetrisConfig::BOARD_HEIGHT];
+};
+
+struct Shape {
+    uint8_t rows[PIECE_SIZE]; // bit j is set if the mino at column j is filled
+    int8_t rot_dx;            // offset applied when rotating clockwise out of this orientation
+    int8_t rot_dy;
+};
+
+static Shape shapes[7][4];
+static bool shapes_ready = false;
+
+static void init_shapes() {
+    for (uint8_t type = 0; type < 7; type++) {
+        uint8_t minos[PIECE_SIZE][PIECE_SIZE];
+        __builtin_memcpy(minos, PIECE_DEFS[type].minos, sizeof(minos));
+
+        for (uint8_t rot = 0; rot < 4; rot++) {
+            Shape& shape = shapes[type][rot];
+            for (uint8_t i = 0; i < PIECE_SIZE; i++) {
+                shape.rows[i] = 0;
+                for (uint8_t j = 0; j < PIECE_SIZE; j++) {
+                    if (minos[i][j]) shape.rows[i] |= 1 << j;
+                }
+            }
+
+            uint8_t rotated[PIECE_SIZE][PIECE_SIZE];
+            compute_rotation(rotated, minos, true, shape.rot_dx, shape.rot_dy);
+            __builtin_memcpy(minos, rotated, sizeof(minos));
+        }
+    }
+
+    shapes_ready = true;
+}
+
+static bool collides(const Bitboard& board, const Shape& shape, const int8_t x, const int8_t y) {
+    if (x + WALL_OFFSET < 0) return true;
+
+    for (uint8_t i = 0; i < PIECE_SIZE; i++) {
+        if (!shape.rows[i]) continue;
+
+        const int8_t row_y = y + i;
+        if (row_y >= TetrisConfig::BOARD_HEIGHT) return true;
+
+        const uint32_t row = row_y < 0 ? ROW_WALLS : board.rows[row_y];
+        if (row & (static_cast<uint32_t>(shape.rows[i]) << (x + WALL_OFFSET))) return true;
+    }
+
+    return false;
+}
+
+/**
+ * Drop the piece from (x, y), lock it and clear lines
+ * @return number of lines cleared
+ */
+static uint8_t place(Bitboard& board, const Shape& shape, const int8_t x, int8_t y) {
+    while (!collides(board, shape, x, y + 1)) y++;
+
+    for (uint8_t i = 0; i < PIECE_SIZE; i++) {
+        const int8_t row_y = y + i;
+        if (!shape.rows[i] || row_y < 0) continue;
+        board.rows[row_y] |= static_cast<uint32_t>(shape.rows[i]) << (x + WALL_OFFSET);
+    }
+
+    uint8_t lines = 0;
+    int8_t dst = TetrisConfig::BOARD_HEIGHT - 1;
+    for (int8_t src = TetrisConfig::BOARD_HEIGHT - 1; src >= 0; src--) {
+        if ((board.rows[src] & ROW_FULL) == ROW_FULL) {
+            lines++;
+            continue;
+        }
+        board.rows[dst--] = board.rows[src];
+    }
+    while (dst >= 0) board.rows[dst--] = ROW_WALLS;
+
+    return lines;
+}
+
+static int32_t evaluate(const Bitboard& board, const uint8_t lines, const AiWeights& w) {
+    int32_t aggregate_height = 0, holes = 0, bumpiness = 0;
+    int32_t prev_height = -1;
+
+    for (uint8_t col = 0; col < TetrisConfig::BOARD_WIDTH; col++) {
+        const uint32_t bit = 1u << (col + WALL_OFFSET);
+        int32_t height = 0;
+
+        for (uint8_t y = 0; y < TetrisConfig::BOARD_HEIGHT; y++) {
+            if (board.rows[y] & bit) {
+                if (height == 0) height = TetrisConfig::BOARD_HEIGHT - y;
+            } else if (height != 0) {
+                holes++;
+            }
+        }
+
+        aggregate_height += height;
+        if (prev_height >= 0) bumpiness += height > prev_height ? height - prev_height : prev_height - height;
+        prev_height = height;
+    }
+
+    return w.aggregate_height * aggregate_height + w.lines * lines + w.holes * holes + w.bumpiness * bumpiness;
+}
+
+/**
+ * Rotate the piece from (x, y) into orientation rot the way the engine would,
+ * then check it can slide sideways to target_x at that height
+ */
+static bool reachable(
+    const Bitboard& board,
+    const uint8_t type,
+    uint8_t cur_rot,
+    int8_t x,
+    int8_t y,
+    const uint8_t rot,
+    const int8_t target_x,
+    int8_t& out_y
+) {
+    while (cur_rot != rot) {
+        const Shape& from = shapes[type][cur_rot];
+        cur_rot = (cur_rot + 1) & 3;
+        x += from.rot_dx;
+        y += from.rot_dy;
+        if (collides(board, shapes[type][cur_rot], x, y)) return false;
+    }
+
+    const Shape& shape = shapes[type][rot];
+    if (collides(board, shape, x, y)) return false;
+
+    const int8_t step = target_x > x ? 1 : -1;
+    while (x != target_x) {
+        x += step;
+        if (collides(board, shape, x, y)) return false;
+    }
+
+    out_y = y;
+    return true;
+}
+
+AiPlacement TetrisAi::search(const TetrisEngine& engine) {
+    if (!shapes_ready) init_shapes();
+
+    Bitboard board;
+    for (uint8_t y = 0; y < TetrisConfig::BOARD_HEIGHT; y++) {
+        board.rows[y] = ROW_WALLS;
+        for (uint8_t x = 0; x < TetrisConfig::BOARD_WIDTH; x++) {
+            if (engine.get_tile(x, y)) board.rows[y] |= 1u << (x + WALL_OFFSET);
+        }
+    }
+
+    const Tetromino& held = engine.get_held();
+    const uint8_t next_type = engine.get_next_piece();
+
+    AiPlacement best = {};
+
+    for (uint8_t rot = 0; rot < 4; rot++) {
+        for (int8_t x = -WALL_OFFSET; x < TetrisConfig::BOARD_WIDTH; x++) {
+            int8_t y;
+            if (!reachable(board, held.type, held.rotation, held.x, held.y, rot, x, y)) continue;
+
+            Bitboard first = board;
+            const uint8_t first_lines = place(first, shapes[held.type][rot], x, y);
+            nodes++;
+
+            // Second ply: best placement of the next piece from its spawn position
+            bool has_second = false;
+            int32_t score = 0;
+            for (uint8_t rot2 = 0; rot2 < 4; rot2++) {
+                for (int8_t x2 = -WALL_OFFSET; x2 < TetrisConfig::BOARD_WIDTH; x2++) {
+                    int8_t y2;
+                    if (!reachable(first, next_type, 0, 3, 0, rot2, x2, y2)) continue;
+
+                    Bitboard second = first;
+                    const uint8_t second_lines = place(second, shapes[next_type][rot2], x2, y2);
+                    const int32_t s = evaluate(second, first_lines + second_lines, weights);
+                    nodes++;
+
+                    if (!has_second || s > score) score = s;
+                    has_second = true;
+                }
+            }
+
+            // The next piece has nowhere to go, so this placement tops out
+            if (!has_second) score = evaluate(first, first_lines, weights) - 1000000;
+
+            if (!best.valid || score > best.score) {
+                best.rotation = rot;
+                best.x = x;
+                best.score = score;
+                best.valid = true;
+            }
+        }
+    }
+
+    return best;
+}
+
+Action TetrisAi::next_action(const TetrisEngine& engine) {
+    switch (engine.get_state()) {
+        case STATE_START:
+            return ACTION_START;
+        case STATE_GAME_OVER:
+            return ACTION_RESTART;
+        case STATE_PAUSED:
+            return ACTION_NONE;
+        default:
+            break;
+    }
+
+    const Tetromino& held = engine.get_held();
+
+    if (engine.get_piece_count() != plan_piece) {
+        plan = search(engine);
+        plan_piece = engine.get_piece_count();
+        rotate_attempts = 0;
+        moved = false;
+    }
+
+    if (!plan.valid) return ACTION_HARD_DROP;
+
+    if (held.rotation != plan.rotation && rotate_attempts < 4) {
+        rotate_attempts++;
+        return ACTION_ROTATE_CW;
+    }
+
+    if (held.x != plan.x) {
+        // Blocked since the last move, so take what we can get
+        if (moved && held.x == last_x) return ACTION_HARD_DROP;
+
+        moved = true;
+        last_x = held.x;
+        return held.x < plan.x ? ACTION_MOVE_RIGHT : ACTION_MOVE_LEFT;
+    }
+
+    return ACTION_HARD_DROP;
+}
@@ -0,0 +1,353 @@
+#include "tetris/engine.hpp"
+
+constexpr PieceDef PIECE_DEFS[7] = {
+    // I piece
+    {{{0, 0, 0, 0}, {1, 1, 1, 1}, {0, 0, 0, 0}, {0, 0, 0, 0}}, 0x00FFFF},
+    // J piece
+    {{{0, 1, 0, 0}, {0, 1, 0, 0}, {1, 1, 0, 0}, {0, 0, 0, 0}}, 0x0000FF},
+    // T piece
+    {{{0, 1, 0, 0}, {1, 1, 1, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}}, 0x800080},
+    // L piece
+    {{{0, 1, 0, 0}, {0, 1, 0, 0}, {0, 1, 1, 0}, {0, 0, 0, 0}}, 0xFFA500},
+    // O piece
+    {{{1, 1, 0, 0}, {1, 1, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}}, 0xFFFF00},
+    // Z piece
+    {{{1, 1, 0, 0}, {0, 1, 1, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}}, 0xFF0000},
+    // S piece
+    {{{0, 1, 1, 0}, {1, 1, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}}, 0x00FF00}
+};
+
+// Same LCG as lib/rand, but kept per engine so games are reproducible from their seed
+int TetrisEngine::rand() {
+    rng_state = rng_state * 1103515245 + 12345;
+    return static_cast<int>(rng_state / 65536) % 32767;
+}
+
+void TetrisEngine::reset(const uint32_t seed) {
+    rng_state = seed;
+    restart();
+}
+
+void TetrisEngine::restart() {
+    state = STATE_START;
+    full_lines = 0;
+    score = 0;
+    level = 1;
+    time = 0;
+    frame_counter = 0;
+    seconds_counter = 0;
+    frames_per_drop = TetrisConfig::INITIAL_FRAMES_PER_DROP;
+    __builtin_memset(board, 0, sizeof(board));
+    bag_size = 0;
+    new_piece();
+    revision++;
+}
+
+void TetrisEngine::new_piece() {
+    if (bag_size == 0) {
+        for (uint8_t i = 0; i < 7; i++) bag_pieces[i] = i;
+        for (uint32_t i = 6; i > 0; --i) {
+            const int j = rand() % (i + 1);
+            const uint8_t tmp = bag_pieces[i];
+            bag_pieces[i] = bag_pieces[j];
+            bag_pieces[j] = tmp;
+        }
+        bag_size = 7;
+    }
+
+    const uint8_t piece_index = bag_pieces[--bag_size];
+
+    held = spawn(piece_index);
+    piece_count++;
+
+    // Store next piece index
+    next_piece_index = (bag_size > 0) ? bag_pieces[bag_size - 1] : 0;
+}
+
+Tetromino TetrisEngine::spawn(const uint8_t type) {
+    Tetromino piece;
+    // Make a COPY of the piece definition so rotation doesn't corrupt the original
+    piece.def = PIECE_DEFS[type];
+    piece.x = 3;
+    piece.y = 0;
+    piece.type = type;
+    piece.rotation = 0;
+    return piece;
+}
+
+bool TetrisEngine::collides(const uint8_t piece[PIECE_SIZE][PIECE_SIZE], const int8_t x, const int8_t y) const {
+    for (uint8_t rel_y = 0; rel_y < PIECE_SIZE; rel_y++) {
+        for (uint8_t rel_x = 0; rel_x < PIECE_SIZE; rel_x++) {
+            if (piece[rel_y][rel_x] == 0) continue;
+
+            const int8_t abs_x = x + rel_x;
+            const int8_t abs_y = y + rel_y;
+
+            // Check bounds
+            if (abs_x < 0 || abs_x >= TetrisConfig::BOARD_WIDTH ||
+                abs_y >= TetrisConfig::BOARD_HEIGHT) {
+                return true;
+            }
+
+            // Check collision with placed blocks (ignore if above board)
+            if (abs_y >= 0 && board[abs_y][abs_x].color != 0) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void TetrisEngine::move(const int8_t dir_x, const int8_t dir_y) {
+    const int8_t next_x = held.x + dir_x;
+    const int8_t next_y = held.y + dir_y;
+
+    if (collides(held.def.minos, next_x, next_y)) {
+        if (dir_y > 0) drop_piece();
+        return;
+    }
+
+    held.x = next_x;
+    held.y = next_y;
+}
+
+void TetrisEngine::hard_drop() {
+    while (!collides(held.def.minos, held.x, held.y + 1)) {
+        held.y++;
+    }
+    drop_piece();
+}
+
+static void compute_rotated(
+    uint8_t dst[PIECE_SIZE][PIECE_SIZE],
+    const uint8_t src[PIECE_SIZE][PIECE_SIZE],
+    const bool clockwise
+) {
+    for (uint8_t i = 0; i < PIECE_SIZE; i++) {
+        for (uint8_t j = 0; j < PIECE_SIZE; j++) {
+            if (clockwise) {
+                dst[j][PIECE_SIZE - 1 - i] = src[i][j];
+            } else {
+                dst[PIECE_SIZE - 1 - j][i] = src[i][j];
+            }
+        }
+    }
+}
+
+static int div_round(const int num, const int den) {
+    if (den == 0) return 0;
+    if (num >= 0) return (num + den / 2) / den;
+    return -((-num + den / 2) / den);
+}
+
+bool compute_rotation(
+    uint8_t dst[PIECE_SIZE][PIECE_SIZE],
+    const uint8_t src[PIECE_SIZE][PIECE_SIZE],
+    const bool clockwise,
+    int8_t& dx,
+    int8_t& dy
+) {
+    compute_rotated(dst, src, clockwise);
+
+    int before_x = 0, before_y = 0;
+    int after_x = 0, after_y = 0;
+    int count = 0;
+
+    for (uint8_t i = 0; i < PIECE_SIZE; i++) {
+        for (uint8_t j = 0; j < PIECE_SIZE; j++) {
+            if (src[i][j]) {
+                before_x += j;
+                before_y += i;
+                count++;
+            }
+            if (dst[i][j]) {
+                after_x += j;
+                after_y += i;
+            }
+        }
+    }
+
+    if (count == 0) return false;
+
+    // Offset to keep piece centered after rotation
+    dx = div_round(before_x - after_x, count);
+    dy = div_round(before_y - after_y, count);
+    return true;
+}
+
+bool TetrisEngine::rotate_piece(Tetromino &piece, const bool clockwise) const {
+    uint8_t rotated[PIECE_SIZE][PIECE_SIZE] = {};
+    int8_t dx, dy;
+    if (!compute_rotation(rotated, piece.def.minos, clockwise, dx, dy)) return false;
+
+    const int8_t new_x = piece.x + dx;
+    const int8_t new_y = piece.y + dy;
+
+    if (collides(rotated, new_x, new_y)) {
+        return false;
+    }
+
+    __builtin_memcpy(piece.def.minos, rotated, PIECE_SIZE * PIECE_SIZE);
+    piece.x = new_x;
+    piece.y = new_y;
+    piece.rotation = (piece.rotation + (clockwise ? 1 : 3)) & 3;
+    return true;
+}
+
+void TetrisEngine::lock(const Tetromino& piece) {
+    for (uint8_t rel_y = 0; rel_y < PIECE_SIZE; rel_y++) {
+        for (uint8_t rel_x = 0; rel_x < PIECE_SIZE; rel_x++) {
+            if (piece.def.minos[rel_y][rel_x] == 0) continue;
+
+            const int8_t abs_x = piece.x + rel_x;
+            const int8_t abs_y = piece.y + rel_y;
+
+            if (abs_x < 0 || abs_x >= TetrisConfig::BOARD_WIDTH ||
+                abs_y < 0 || abs_y >= TetrisConfig::BOARD_HEIGHT) {
+                continue;
+            }
+
+            board[abs_y][abs_x].color = piece.def.color;
+        }
+    }
+
+    check_row();
+}
+
+void TetrisEngine::drop_piece() {
+    lock(held);
+    new_piece();
+
+    // Game over if new piece immediately collides
+    if (collides(held.def.minos, held.x, held.y + 1)) {
+        state = STATE_GAME_OVER;
+    }
+}
+
+void TetrisEngine::check_row() {
+    uint8_t lines_cleared = 0;
+
+    for (int16_t y = TetrisConfig::BOARD_HEIGHT - 1; y >= 0; y--) {
+        bool is_full = true;
+        bool is_empty = true;
+
+        for (uint8_t x = 0; x < TetrisConfig::BOARD_WIDTH; x++) {
+            if (board[y][x].color == 0) {
+                is_full = false;
+            } else {
+                is_empty = false;
+            }
+        }
+
+        if (is_empty) break;
+
+        if (is_full) {
+            // Shift all rows above down
+            for (int16_t y2 = y; y2 > 0; y2--) {
+                __builtin_memcpy(board[y2], board[y2 - 1], sizeof(Tile) * TetrisConfig::BOARD_WIDTH);
+            }
+            __builtin_memset(board[0], 0, sizeof(Tile) * TetrisConfig::BOARD_WIDTH);
+
+            y++; // Check this row again
+            full_lines++;
+            lines_cleared++;
+        }
+    }
+
+    // Update level and speed
+    const uint32_t new_level = (full_lines / TetrisConfig::LINES_PER_LEVEL) + 1;
+    if (new_level > level) {
+        level = new_level;
+        frames_per_drop = TetrisConfig::INITIAL_FRAMES_PER_DROP - (level * 5);
+        if (frames_per_drop < TetrisConfig::MIN_FRAMES_PER_DROP) {
+            frames_per_drop = TetrisConfig::MIN_FRAMES_PER_DROP;
+        }
+    }
+
+    if (lines_cleared > 0 && lines_cleared <= 4) {
+        constexpr uint32_t line_scores[4] = {100, 300, 500, 800};
+        score += line_scores[lines_cleared - 1] * level;
+    }
+}
+
+void TetrisEngine::tick() {
+    if (state != STATE_ACTIVE) return;
+
+    // Automatic piece drop
+    frame_counter++;
+    if (frame_counter >= frames_per_drop) {
+        move(0, 1);
+        frame_counter = 0;
+        revision++;
+    }
+
+    // Time tracking
+    seconds_counter++;
+    if (seconds_counter >= TetrisConfig::FRAMES_PER_SECOND) {
+        time++;
+        seconds_counter = 0;
+        revision++;
+    }
+}
+
+void TetrisEngine::apply(const Action action) {
+    if (action == ACTION_NONE) return;
+    revision++;
+
+    switch (action) {
+        case ACTION_START:
+            if (state == STATE_START) {
+                state = STATE_ACTIVE;
+                new_piece();
+            }
+            return;
+
+        case ACTION_PAUSE:
+            if (state == STATE_ACTIVE) {
+                state = STATE_PAUSED;
+            } else if (state == STATE_PAUSED) {
+                state = STATE_ACTIVE;
+            }
+            return;
+
+        case ACTION_RESTART:
+            restart();
+            return;
+
+        default:
+            break;
+    }
+
+    // Piece movement only applies while a game is in progress
+    if (state != STATE_ACTIVE) return;
+
+    switch (action) {
+        case ACTION_MOVE_LEFT:
+            move(-1, 0);
+            break;
+
+        case ACTION_MOVE_RIGHT:
+            move(1, 0);
+            break;
+
+        case ACTION_SOFT_DROP:
+            move(0, 1);
+            break;
+
+        case ACTION_HARD_DROP:
+            hard_drop();
+            break;
+
+        case ACTION_ROTATE_CW:
+            rotate_piece(held, true);
+            break;
+
+        case ACTION_ROTATE_CCW:
+            rotate_piece(held, false);
+            break;
+
+        default:
+            break;
+    }
+}
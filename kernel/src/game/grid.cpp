@@ -0,0 +1,201 @@
+#include "tetris/grid.hpp"
+
+#include "driver/screen.hpp"
+#include "driver/tsc.hpp"
+#include "lib/log.hpp"
+#include "tetris/ai.hpp"
+#include "tetris/engine.hpp"
+#include "tetris/input.hpp"
+#include "tetris/render.hpp"
+#include "tetris/replay.hpp"
+
+// Time between reports, and between doubling the board count
+#define GRID_STEP_NS    5000000000ull
+// Each board is drawn with a one block border around it
+#define CELL_BLOCKS_X   (TetrisConfig::BOARD_WIDTH + 2)
+#define CELL_BLOCKS_Y   (TetrisConfig::BOARD_HEIGHT + 2)
+
+struct GridBoard {
+    TetrisEngine engine;
+    TetrisAi ai;
+    ReplayReader replay;
+    InputController input;
+    uint64_t tick;
+};
+
+uint32_t TetrisGrid::board_count = 0;
+uint32_t TetrisGrid::target_count = 0;
+
+static GridBoard boards[GRID_MAX_BOARDS];
+static uint32_t base_seed;
+static const uint8_t* replay_data;
+static size_t replay_data_size;
+
+static uint16_t block_size;
+static uint32_t columns;
+static int32_t origin_x;
+static int32_t origin_y;
+
+static uint64_t report_start;
+static uint64_t frames;
+static uint64_t moves;
+static uint64_t board_ticks;
+static uint64_t clear_cycles, sim_cycles, draw_cycles, flush_cycles;
+
+void TetrisGrid::init(uint32_t count, const uint32_t seed, const uint8_t* replay, const size_t replay_size) {
+    if (count > GRID_MAX_BOARDS) count = GRID_MAX_BOARDS;
+    if (count == 0) count = 1;
+
+    target_count = count;
+    base_seed = seed;
+    replay_data = replay;
+    replay_data_size = replay_size;
+
+    logger.info(
+        "Grid: stress mode with up to %u boards driven by %s",
+        target_count,
+        replay ? "the replay log" : "the agent"
+    );
+
+    board_count = 0;
+    add_boards(1);
+}
+
+void TetrisGrid::add_boards(uint32_t count) {
+    if (board_count + count > target_count) count = target_count - board_count;
+
+    for (uint32_t i = board_count; i < board_count + count; i++) {
+        GridBoard& board = boards[i];
+        board.tick = 0;
+        board.ai = TetrisAi();
+
+        if (replay_data && board.replay.open(replay_data, replay_data_size)) {
+            board.engine.reset(board.replay.get_seed());
+            board.input.reset();
+            board.input.configure(board.replay.get_repeat());
+        } else {
+            board.engine.reset(base_seed + i);
+        }
+    }
+
+    board_count += count;
+    layout();
+
+    report_start = tsc::now_ns();
+    frames = moves = board_ticks = 0;
+    clear_cycles = sim_cycles = draw_cycles = flush_cycles = 0;
+}
+
+void TetrisGrid::layout() {
+    // Pick the column count that gives the largest blocks
+    block_size = 0;
+    for (uint32_t cols = 1; cols <= board_count; cols++) {
+        const uint32_t rows = (board_count + cols - 1) / cols;
+        const uint32_t size_x = framebuffer.width / (cols * CELL_BLOCKS_X);
+        const uint32_t size_y = framebuffer.height / (rows * CELL_BLOCKS_Y);
+        const uint32_t size = size_x < size_y ? size_x : size_y;
+
+        if (size > block_size) {
+            block_size = size;
+            columns = cols;
+        }
+    }
+    if (block_size == 0) {
+        block_size = 1;
+        columns = framebuffer.width / CELL_BLOCKS_X;
+    }
+
+    const uint32_t rows = (board_count + columns - 1) / columns;
+    origin_x = (framebuffer.width - columns * CELL_BLOCKS_X * block_size) / 2;
+    origin_y = (framebuffer.height - rows * CELL_BLOCKS_Y * block_size) / 2;
+}
+
+static void step_board(GridBoard& board) {
+    if (replay_data) {
+        if (board.replay.done()) {
+            board.replay.open(replay_data, replay_data_size);
+            board.engine.reset(board.replay.get_seed());
+            board.input.reset();
+            board.tick = 0;
+        }
+
+        KeyEvent ev;
+        while (!board.replay.done() && board.replay.next_tick() <= board.tick && board.replay.next(ev)) {
+            if (board.input.key(board.engine, ev) != ACTION_NONE) moves++;
+        }
+        moves += board.input.tick(board.engine);
+    } else {
+        const Action action = board.ai.next_action(board.engine);
+        if (action != ACTION_NONE) moves++;
+        board.engine.apply(action);
+    }
+
+    board.engine.tick();
+    board.tick++;
+}
+
+void TetrisGrid::update() {
+    const uint64_t frame_start = tsc::now_cycles();
+    screen::clear();
+
+    const uint64_t sim_start = tsc::now_cycles();
+    for (uint32_t i = 0; i < board_count; i++) step_board(boards[i]);
+    board_ticks += board_count;
+
+    const uint64_t draw_start = tsc::now_cycles();
+    for (uint32_t i = 0; i < board_count; i++) {
+        const int32_t cell_x = origin_x + (i % columns) * CELL_BLOCKS_X * block_size;
+        const int32_t cell_y = origin_y + (i / columns) * CELL_BLOCKS_Y * block_size;
+
+        screen::draw_rect_outline(
+            cell_x,
+            cell_y,
+            CELL_BLOCKS_X * block_size,
+            CELL_BLOCKS_Y * block_size,
+            block_size,
+            TetrisConfig::BORDER_COLOR
+        );
+        draw_board(boards[i].engine, cell_x + block_size, cell_y + block_size, block_size);
+    }
+
+    const uint64_t flush_start = tsc::now_cycles();
+    screen::flush();
+    const uint64_t frame_end = tsc::now_cycles();
+
+    clear_cycles += sim_start - frame_start;
+    sim_cycles += draw_start - sim_start;
+    draw_cycles += flush_start - draw_start;
+    flush_cycles += frame_end - flush_start;
+    frames++;
+
+    if (tsc::now_ns() - report_start >= GRID_STEP_NS) {
+        report();
+        if (board_count < target_count) add_boards(board_count);
+    }
+}
+
+void TetrisGrid::report() {
+    const uint64_t ms = (tsc::now_ns() - report_start) / 1000000;
+    if (ms == 0 || frames == 0) return;
+
+    logger.info(
+        "Grid: %u boards (block %u px): %lu moves/s, %lu board ticks/s, %lu fps",
+        board_count,
+        block_size,
+        moves * 1000 / ms,
+        board_ticks * 1000 / ms,
+        frames * 1000 / ms
+    );
+    logger.info(
+        "Grid: frame %lu us (clear %lu, sim %lu, draw %lu, flush %lu)",
+        tsc::cycles_to_ns((clear_cycles + sim_cycles + draw_cycles + flush_cycles) / frames) / 1000,
+        tsc::cycles_to_ns(clear_cycles / frames) / 1000,
+        tsc::cycles_to_ns(sim_cycles / frames) / 1000,
+        tsc::cycles_to_ns(draw_cycles / frames) / 1000,
+        tsc::cycles_to_ns(flush_cycles / frames) / 1000
+    );
+
+    report_start = tsc::now_ns();
+    frames = moves = board_ticks = 0;
+    clear_cycles = sim_cycles = draw_cycles = flush_cycles = 0;
+}
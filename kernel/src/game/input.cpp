@@ -0,0 +1,168 @@
+#include "tetris/input.hpp"
+
+Action key_to_action(const KeyEvent ev, const GameState state) {
+    if (ev.break_key) return ACTION_NONE;
+
+    switch (ev.scancode) {
+        case KEY_X:
+        case KEY_W:
+        case KEY_ARROW_UP:
+            return ACTION_ROTATE_CW;
+
+        case KEY_Z:
+        case KEY_CONTROL:
+            return ACTION_ROTATE_CCW;
+
+        case KEY_S:
+        case KEY_ARROW_DOWN:
+            return ACTION_SOFT_DROP;
+
+        case KEY_A:
+        case KEY_ARROW_LEFT:
+            return ACTION_MOVE_LEFT;
+
+        case KEY_D:
+        case KEY_ARROW_RIGHT:
+            return ACTION_MOVE_RIGHT;
+
+        case KEY_SPACE:
+            return state == STATE_START ? ACTION_START : ACTION_HARD_DROP;
+
+        case KEY_R:
+            return ACTION_RESTART;
+
+        case KEY_ESCAPE:
+        case KEY_P:
+            return ACTION_PAUSE;
+
+        default:
+            return ACTION_NONE;
+    }
+}
+
+bool char_to_key(const char c, uint8_t& scancode) {
+    // Setting bit 5 lower-cases letters and leaves space alone
+    switch (c | 0x20) {
+        case 'w': scancode = KEY_W; break;
+        case 'a': scancode = KEY_A; break;
+        case 's': scancode = KEY_S; break;
+        case 'd': scancode = KEY_D; break;
+        case 'x': scancode = KEY_X; break;
+        case 'z': scancode = KEY_Z; break;
+        case 'p': scancode = KEY_P; break;
+        case 'r': scancode = KEY_R; break;
+        case 'h': scancode = KEY_F1; break;
+        case ' ': scancode = KEY_SPACE; break;
+        default: return false;
+    }
+    return true;
+}
+
+bool action_to_key(const Action action, uint8_t& scancode) {
+    switch (action) {
+        case ACTION_MOVE_LEFT: scancode = KEY_A; break;
+        case ACTION_MOVE_RIGHT: scancode = KEY_D; break;
+        case ACTION_SOFT_DROP: scancode = KEY_S; break;
+        case ACTION_HARD_DROP: scancode = KEY_SPACE; break;
+        case ACTION_ROTATE_CW: scancode = KEY_X; break;
+        case ACTION_ROTATE_CCW: scancode = KEY_Z; break;
+        case ACTION_START: scancode = KEY_SPACE; break;
+        case ACTION_PAUSE: scancode = KEY_P; break;
+        case ACTION_RESTART: scancode = KEY_R; break;
+        default: return false;
+    }
+    return true;
+}
+
+void InputController::configure(const RepeatConfig repeat) {
+    timing = repeat;
+}
+
+void InputController::reset() {
+    left = right = down = false;
+    shift = ACTION_NONE;
+    shift_ticks = drop_ticks = 0;
+}
+
+void InputController::press_shift(const Action direction) {
+    bool& held = direction == ACTION_MOVE_LEFT ? left : right;
+    held = true;
+    shift = direction;
+    shift_ticks = 0;
+}
+
+void InputController::release_shift(const Action direction) {
+    bool& held = direction == ACTION_MOVE_LEFT ? left : right;
+    held = false;
+    if (shift != direction) return;
+
+    // Fall back to the opposite direction if it is still held, charging DAS again
+    const bool other_held = direction == ACTION_MOVE_LEFT ? right : left;
+    shift = other_held ? (direction == ACTION_MOVE_LEFT ? ACTION_MOVE_RIGHT : ACTION_MOVE_LEFT) : ACTION_NONE;
+    shift_ticks = 0;
+}
+
+Action InputController::key(TetrisEngine& engine, KeyEvent ev) {
+    const bool released = ev.break_key;
+    ev.break_key = false;
+    const Action action = key_to_action(ev, engine.get_state());
+
+    if (released) {
+        if (action == ACTION_MOVE_LEFT || action == ACTION_MOVE_RIGHT) release_shift(action);
+        if (action == ACTION_SOFT_DROP) down = false;
+        return ACTION_NONE;
+    }
+
+    switch (action) {
+        case ACTION_MOVE_LEFT:
+        case ACTION_MOVE_RIGHT:
+            if (action == ACTION_MOVE_LEFT ? left : right) return ACTION_NONE;
+            press_shift(action);
+            break;
+
+        case ACTION_SOFT_DROP:
+            if (down) return ACTION_NONE;
+            down = true;
+            drop_ticks = 0;
+            break;
+
+        default:
+            break;
+    }
+
+    engine.apply(action);
+    return action;
+}
+
+uint32_t InputController::repeat_shift(TetrisEngine& engine) {
+    if (shift == ACTION_NONE) return 0;
+
+    shift_ticks++;
+    if (shift_ticks < timing.das_ticks) return 0;
+
+    if (timing.arr_ticks == 0) {
+        // Shift all the way to the wall
+        for (uint8_t i = 0; i < TetrisConfig::BOARD_WIDTH; i++) engine.apply(shift);
+        return 1;
+    }
+
+    if ((shift_ticks - timing.das_ticks) % timing.arr_ticks != 0) return 0;
+    engine.apply(shift);
+    return 1;
+}
+
+uint32_t InputController::tick(TetrisEngine& engine) {
+    if (engine.get_state() != STATE_ACTIVE) return 0;
+
+    uint32_t applied = repeat_shift(engine);
+
+    if (down) {
+        drop_ticks++;
+        if (timing.soft_drop_ticks && drop_ticks % timing.soft_drop_ticks == 0) {
+            engine.apply(ACTION_SOFT_DROP);
+            applied++;
+        }
+    }
+
+    return applied;
+}
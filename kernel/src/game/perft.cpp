@@ -0,0 +1,167 @@
+#include "tetris/perft.hpp"
+
+// Reachable origins: every mino column is 0..3 so x stays within -3..9, and the
+// rotation offsets never move a piece more than 2 rows above its spawn row
+#define X_MIN       (-4)
+#define Y_MIN       (-4)
+#define X_RANGE     16
+#define Y_RANGE     28
+#define STATE_COUNT (4 * X_RANGE * Y_RANGE)
+#define MAX_LOCKS   256
+
+struct PieceState {
+    uint8_t rotation;
+    int8_t x;
+    int8_t y;
+};
+
+struct Orientations {
+    uint8_t minos[4][PIECE_SIZE][PIECE_SIZE];
+};
+
+static uint16_t state_index(const PieceState& s) {
+    return (s.rotation * X_RANGE + (s.x - X_MIN)) * Y_RANGE + (s.y - Y_MIN);
+}
+
+static bool in_range(const PieceState& s) {
+    return s.x >= X_MIN && s.x < X_MIN + X_RANGE && s.y >= Y_MIN && s.y < Y_MIN + Y_RANGE;
+}
+
+static Tetromino to_piece(const Orientations& o, const uint8_t type, const PieceState& s) {
+    Tetromino piece = TetrisEngine::spawn(type);
+    __builtin_memcpy(piece.def.minos, o.minos[s.rotation], sizeof(piece.def.minos));
+    piece.x = s.x;
+    piece.y = s.y;
+    piece.rotation = s.rotation;
+    return piece;
+}
+
+// The 4 occupied cells, sorted and packed, identify a lock position
+static uint32_t cells_key(const Tetromino& piece) {
+    uint8_t cells[4];
+    uint8_t n = 0;
+    for (uint8_t rel_y = 0; rel_y < PIECE_SIZE; rel_y++) {
+        for (uint8_t rel_x = 0; rel_x < PIECE_SIZE; rel_x++) {
+            if (!piece.def.minos[rel_y][rel_x] || n == 4) continue;
+            cells[n++] = (piece.y + rel_y - Y_MIN) * TetrisConfig::BOARD_WIDTH + piece.x + rel_x;
+        }
+    }
+
+    for (uint8_t i = 1; i < n; i++) {
+        for (uint8_t j = i; j > 0 && cells[j - 1] > cells[j]; j--) {
+            const uint8_t tmp = cells[j];
+            cells[j] = cells[j - 1];
+            cells[j - 1] = tmp;
+        }
+    }
+
+    uint32_t key = 0;
+    for (uint8_t i = 0; i < n; i++) key = (key << 8) | cells[i];
+    return key;
+}
+
+/**
+ * Breadth-first search over (rotation, x, y) from the spawn position. Kept out
+ * of line so its scratch space isn't held on the stack while perft recurses.
+ * @return number of distinct lock positions written to locks
+ */
+__attribute__((noinline)) static uint16_t generate(
+    const TetrisEngine& engine,
+    const uint8_t type,
+    const Orientations& o,
+    PieceState* locks
+) {
+    uint64_t visited[(STATE_COUNT + 63) / 64] = {};
+    PieceState queue[STATE_COUNT];
+    uint32_t keys[MAX_LOCKS];
+    uint16_t head = 0, tail = 0, lock_count = 0;
+
+    const PieceState start = {0, 3, 0};
+    if (engine.collides(o.minos[0], start.x, start.y)) return 0;
+
+    queue[tail++] = start;
+    visited[state_index(start) / 64] |= 1ull << (state_index(start) % 64);
+
+    while (head != tail) {
+        const PieceState s = queue[head++];
+        const Tetromino piece = to_piece(o, type, s);
+
+        PieceState next[5];
+        uint8_t next_count = 0;
+
+        if (!engine.collides(piece.def.minos, s.x - 1, s.y)) next[next_count++] = {s.rotation, static_cast<int8_t>(s.x - 1), s.y};
+        if (!engine.collides(piece.def.minos, s.x + 1, s.y)) next[next_count++] = {s.rotation, static_cast<int8_t>(s.x + 1), s.y};
+
+        if (!engine.collides(piece.def.minos, s.x, s.y + 1)) {
+            next[next_count++] = {s.rotation, s.x, static_cast<int8_t>(s.y + 1)};
+        } else {
+            const uint32_t key = cells_key(piece);
+            bool seen = false;
+            for (uint16_t i = 0; i < lock_count && !seen; i++) seen = keys[i] == key;
+            if (!seen && lock_count < MAX_LOCKS) {
+                keys[lock_count] = key;
+                locks[lock_count++] = s;
+            }
+        }
+
+        Tetromino rotated = piece;
+        if (engine.rotate_piece(rotated, true)) next[next_count++] = {rotated.rotation, rotated.x, rotated.y};
+        rotated = piece;
+        if (engine.rotate_piece(rotated, false)) next[next_count++] = {rotated.rotation, rotated.x, rotated.y};
+
+        for (uint8_t i = 0; i < next_count; i++) {
+            if (!in_range(next[i])) continue;
+            const uint16_t index = state_index(next[i]);
+            if (visited[index / 64] & (1ull << (index % 64))) continue;
+            visited[index / 64] |= 1ull << (index % 64);
+            queue[tail++] = next[i];
+        }
+    }
+
+    return lock_count;
+}
+
+static void init_orientations(Orientations& o, const uint8_t type) {
+    __builtin_memcpy(o.minos[0], PIECE_DEFS[type].minos, sizeof(o.minos[0]));
+    for (uint8_t rot = 1; rot < 4; rot++) {
+        int8_t dx, dy;
+        compute_rotation(o.minos[rot], o.minos[rot - 1], true, dx, dy);
+    }
+}
+
+uint64_t perft(const TetrisEngine& engine, const uint8_t* queue, const uint8_t depth) {
+    if (depth == 0) return 1;
+
+    Orientations o;
+    init_orientations(o, queue[0]);
+
+    PieceState locks[MAX_LOCKS];
+    const uint16_t lock_count = generate(engine, queue[0], o, locks);
+    if (depth == 1) return lock_count;
+
+    uint64_t nodes = 0;
+    for (uint16_t i = 0; i < lock_count; i++) {
+        TetrisEngine child = engine;
+        child.lock(to_piece(o, queue[0], locks[i]));
+        nodes += perft(child, queue + 1, depth - 1);
+    }
+
+    return nodes;
+}
+
+int perft_parse_queue(const char* str, uint8_t* queue, const uint8_t max) {
+    int n = 0;
+    for (; *str && n < max; str++) {
+        switch (*str) {
+            case 'I': queue[n++] = PIECE_I; break;
+            case 'J': queue[n++] = PIECE_J; break;
+            case 'T': queue[n++] = PIECE_T; break;
+            case 'L': queue[n++] = PIECE_L; break;
+            case 'O': queue[n++] = PIECE_O; break;
+            case 'Z': queue[n++] = PIECE_Z; break;
+            case 'S': queue[n++] = PIECE_S; break;
+            default: return -1;
+        }
+    }
+    return n;
+}
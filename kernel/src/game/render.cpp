@@ -0,0 +1,142 @@
+#include "tetris/render.hpp"
+
+#include "driver/pmu.hpp"
+#include "driver/screen.hpp"
+#include "kernel/frame_stats.hpp"
+#include "kernel/latency.hpp"
+#include "lib/format.hpp"
+#include "tetris/color_utils.hpp"
+
+#define HUD_LINES        (PHASE_COUNT + 6)
+#define HUD_COLUMNS      26
+#define HUD_SPARK_HEIGHT 24 // before scaling
+#define HUD_TEXT_COLOR   0xCCCCCC
+#define HUD_BG_COLOR     0x101010
+#define HUD_SPARK_COLOR  0x1ED760
+#define HUD_SLOW_COLOR   0xE04040 // frames half again as long as the average
+
+void draw_tile(const uint32_t x, const uint32_t y, const uint16_t size, const uint32_t color) {
+    if (size < 3) {
+        screen::draw_rect(x, y, size, size, color);
+        return;
+    }
+
+    // Base color
+    screen::draw_rect(x, y, size, size, color);
+
+    const uint16_t inset = size / 8 + 1;
+
+    // Top highlight
+    const uint32_t highlight = lighten_color(color, 25);
+    const uint16_t hl_height = size / 3;
+    screen::draw_rect(x + inset, y + inset, size - inset * 2, hl_height, highlight);
+
+    // Left highlight
+    const uint32_t left_hl = lighten_color(color, 12);
+    const uint16_t left_width = size / 6;
+    screen::draw_rect(x + inset, y + inset + hl_height, left_width, size - inset * 2 - hl_height, left_hl);
+
+    // Bottom shadow
+    const uint32_t shadow = darken_color(color, 30);
+    const uint16_t shadow_height = size / 3;
+    screen::draw_rect(x + inset, y + size - inset - shadow_height, size - inset * 2, shadow_height, shadow);
+
+    // Outline
+    const uint32_t outline = darken_color(color, 45);
+    screen::draw_rect(x, y, size, 1, outline);
+    screen::draw_rect(x, y, 1, size, outline);
+    screen::draw_rect(x, y + size - 1, size, 1, outline);
+    screen::draw_rect(x + size - 1, y, 1, size, outline);
+}
+
+void draw_board(const TetrisEngine& engine, const int32_t x, const int32_t y, const uint16_t block_size) {
+    for (uint8_t by = 0; by < TetrisConfig::BOARD_HEIGHT; by++) {
+        for (uint8_t bx = 0; bx < TetrisConfig::BOARD_WIDTH; bx++) {
+            const uint32_t color = engine.get_tile(bx, by);
+            if (color == 0) continue;
+            draw_tile(x + bx * block_size, y + by * block_size, block_size, color);
+        }
+    }
+
+    if (engine.get_state() == STATE_START) return;
+
+    const Tetromino& held = engine.get_held();
+    for (uint8_t rel_y = 0; rel_y < PIECE_SIZE; rel_y++) {
+        for (uint8_t rel_x = 0; rel_x < PIECE_SIZE; rel_x++) {
+            if (held.def.minos[rel_y][rel_x] == 0) continue;
+            const int32_t grid_y = held.y + rel_y;
+            if (grid_y < 0) continue;
+            draw_tile(x + (held.x + rel_x) * block_size, y + grid_y * block_size, block_size, held.def.color);
+        }
+    }
+}
+
+void draw_hud(const uint32_t x, const uint32_t y, const float scale) {
+    static FrameStats stats;
+    frame_stats::get(stats);
+
+    const uint32_t line_height = 10 * scale;
+    const uint32_t pad = 4 * scale;
+    const uint32_t spark_height = HUD_SPARK_HEIGHT * scale;
+    const uint32_t bar_width = scale < 2 ? 2 : static_cast<uint32_t>(scale);
+    const uint32_t text_width = HUD_COLUMNS * 8 * scale;
+    const uint32_t spark_width = FRAME_STATS_WINDOW * bar_width;
+    const uint32_t width = (text_width > spark_width ? text_width : spark_width) + pad * 2;
+    const uint32_t height = HUD_LINES * line_height + spark_height + pad * 3;
+
+    screen::draw_rect(x, y, width, height, HUD_BG_COLOR);
+
+    uint32_t text_y = y + pad;
+    const auto line = [&](const char* text) {
+        screen::draw(text, x + pad, text_y, scale, HUD_TEXT_COLOR);
+        text_y += line_height;
+    };
+
+    line(StackString<HUD_COLUMNS + 1>("FPS %u", stats.fps));
+    line(StackString<HUD_COLUMNS + 1>("frame %u/%u/%u us", stats.frame_min_us, stats.frame_avg_us, stats.frame_max_us));
+    const LatencyStats input = latency::get_stats();
+    line(StackString<HUD_COLUMNS + 1>("input %lu/%lu/%lu us", input.p50_us, input.p99_us, input.max_us));
+
+    // With a PMU each phase also shows its IPC and LLC misses per frame
+    const bool pmu = pmu::has_event(PMU_CYCLES) && pmu::has_event(PMU_INSTRUCTIONS);
+    line(pmu ? "phase     us  IPC   LLC" : "phase     us");
+    for (uint8_t phase = 0; phase < PHASE_COUNT; phase++) {
+        const auto p = static_cast<FramePhase>(phase);
+        StackString<HUD_COLUMNS + 1> text(" %-5s %6u", frame_stats::phase_name(p), stats.phase_us[phase]);
+        if (pmu) {
+            const uint64_t* events = stats.phase_events[phase];
+            const uint64_t ipc = events[PMU_CYCLES] ? events[PMU_INSTRUCTIONS] * 100 / events[PMU_CYCLES] : 0;
+            const uint64_t llc = events[PMU_LLC_MISSES];
+            text.append(" %lu.%02lu", ipc / 100, ipc % 100);
+            if (llc < 100000) {
+                text.append(" %5lu", llc);
+            } else {
+                text.append(" %4luk", llc / 1000);
+            }
+        }
+        line(text);
+    }
+    line(StackString<HUD_COLUMNS + 1>("heap %zu KiB", stats.heap_used / 1024));
+
+    StackString<HUD_COLUMNS + 1> irqs("irq/s");
+    for (uint32_t irq = 0; irq < IRQ_COUNT; irq++) {
+        if (stats.irqs[irq]) irqs.append(" %u:%u", irq, stats.irqs[irq]);
+    }
+    line(irqs);
+
+    // One bar per frame, scaled to the slowest frame in the window
+    const uint32_t spark_y = text_y + pad;
+    const uint32_t slow_us = stats.frame_avg_us + stats.frame_avg_us / 2;
+    for (uint32_t i = 0; i < stats.frames; i++) {
+        const uint32_t us = stats.frame_us[i];
+        uint32_t bar = stats.frame_max_us ? static_cast<uint64_t>(us) * spark_height / stats.frame_max_us : 0;
+        if (bar == 0) bar = 1;
+        screen::draw_rect(
+            x + pad + i * bar_width,
+            spark_y + spark_height - bar,
+            bar_width - 1,
+            bar,
+            us > slow_us ? HUD_SLOW_COLOR : HUD_SPARK_COLOR
+        );
+    }
+}
@@ -0,0 +1,125 @@
+#include "tetris/replay.hpp"
+
+static constexpr uint8_t replay_magic[4] = {'T', 'R', 'P', 'L'};
+
+void ReplayRecorder::begin(uint8_t* buffer, const size_t capacity, const uint32_t seed, const RepeatConfig repeat) {
+    buf = buffer;
+    cap = capacity;
+    len = 0;
+    last_tick = 0;
+    overflow = false;
+
+    if (cap < REPLAY_HEADER_SIZE) {
+        overflow = true;
+        return;
+    }
+
+    for (const uint8_t b : replay_magic) buf[len++] = b;
+    buf[len++] = REPLAY_VERSION;
+    for (uint8_t i = 0; i < 4; i++) buf[len++] = (seed >> (i * 8)) & 0xFF;
+    buf[len++] = repeat.das_ticks;
+    buf[len++] = repeat.arr_ticks;
+    buf[len++] = repeat.soft_drop_ticks;
+}
+
+bool ReplayRecorder::record(const uint64_t tick, const KeyEvent ev) {
+    if (overflow) return false;
+
+    // Worst case is a 10 byte varint plus the scancode and flags
+    uint8_t tmp[12];
+    uint8_t n = 0;
+
+    uint64_t delta = tick - last_tick;
+    do {
+        uint8_t b = delta & 0x7F;
+        delta >>= 7;
+        if (delta) b |= 0x80;
+        tmp[n++] = b;
+    } while (delta);
+
+    tmp[n++] = ev.scancode;
+    tmp[n++] = (ev.break_key ? REPLAY_FLAG_BREAK : 0) | (ev.extended_key ? REPLAY_FLAG_EXTENDED : 0);
+
+    if (len + n > cap) {
+        overflow = true;
+        return false;
+    }
+
+    for (uint8_t i = 0; i < n; i++) buf[len++] = tmp[i];
+    last_tick = tick;
+    return true;
+}
+
+bool ReplayReader::open(const uint8_t* data, const size_t size) {
+    buf = data;
+    len = size;
+    pos = 0;
+    seed = 0;
+    has_pending = false;
+    pending_tick = 0;
+
+    if (!data || size < REPLAY_HEADER_SIZE) return false;
+    for (uint8_t i = 0; i < 4; i++) {
+        if (data[i] != replay_magic[i]) return false;
+    }
+    if (data[4] != REPLAY_VERSION) return false;
+
+    for (uint8_t i = 0; i < 4; i++) seed |= static_cast<uint32_t>(data[5 + i]) << (i * 8);
+    repeat = {data[9], data[10], data[11]};
+
+    pos = REPLAY_HEADER_SIZE;
+    decode_next();
+    return true;
+}
+
+void ReplayReader::decode_next() {
+    has_pending = false;
+
+    uint64_t delta = 0;
+    uint8_t shift = 0;
+    for (;;) {
+        if (pos >= len || shift > 63) return;
+        const uint8_t b = buf[pos++];
+        delta |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if (!(b & 0x80)) break;
+        shift += 7;
+    }
+
+    if (pos + 2 > len) return; // truncated record
+
+    pending.scancode = buf[pos++];
+    const uint8_t flags = buf[pos++];
+    pending.break_key = flags & REPLAY_FLAG_BREAK;
+    pending.extended_key = flags & REPLAY_FLAG_EXTENDED;
+    pending_tick += delta;
+    has_pending = true;
+}
+
+bool ReplayReader::next(KeyEvent& ev) {
+    if (!has_pending) return false;
+    ev = pending;
+    decode_next();
+    return true;
+}
+
+ReplayResult replay_run(TetrisEngine& engine, ReplayReader& reader) {
+    ReplayResult result = {};
+    engine.reset(reader.get_seed());
+
+    InputController input;
+    input.configure(reader.get_repeat());
+
+    while (!reader.done()) {
+        KeyEvent ev;
+        while (!reader.done() && reader.next_tick() <= result.ticks && reader.next(ev)) {
+            input.key(engine, ev);
+            result.events++;
+        }
+
+        input.tick(engine);
+        engine.tick();
+        result.ticks++;
+    }
+
+    return result;
+}
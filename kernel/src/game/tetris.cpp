@@ -2,54 +2,43 @@
 
 #include "driver/ps2/keyboard.hpp"
 #include "driver/screen.hpp"
-#include "memory/mem.hpp"
-#include "lib/rand.hpp"
+#include "driver/serial.hpp"
+#include "driver/tsc.hpp"
 #include "lib/format.hpp"
 #include "lib/log.hpp"
-#include "tetris/color_utils.hpp"
+#include "kernel/frame_stats.hpp"
+#include "kernel/latency.hpp"
+#include "kernel/system.hpp"
+#include "tetris/ai.hpp"
+#include "tetris/input.hpp"
+#include "tetris/render.hpp"
+#include "tetris/replay.hpp"
 #include "lib/string.hpp"
 
-namespace TetrisConfig {
-    constexpr uint16_t BOARD_HEIGHT = 20;
-    constexpr uint16_t BOARD_WIDTH = 10;
-    constexpr uint32_t FRAMES_PER_SECOND = 100;
-    constexpr uint32_t INITIAL_FRAMES_PER_DROP = 100;
-    constexpr uint32_t LINES_PER_LEVEL = 10;
-    constexpr uint32_t MIN_FRAMES_PER_DROP = 10;
-    constexpr uint32_t BORDER_COLOR = 0x333333;
-}
+#define REPLAY_BUFFER_SIZE  (256 * 1024) // minutes of autoplay, which taps a key every tick
+#define AI_REPORT_TICKS     1000
+
+TetrisEngine Tetris::engine;
+uint64_t Tetris::sim_tick = 0;
+uint32_t Tetris::drawn_revision = 0;
+
+static uint8_t replay_buffer[REPLAY_BUFFER_SIZE];
+static ReplayRecorder recorder;
+static ReplayReader playback;
+static bool recording = false;
+static bool playing_back = false;
 
-constexpr PieceDef PIECE_DEFS[7] = {
-    // I piece
-    {{{0, 0, 0, 0}, {1, 1, 1, 1}, {0, 0, 0, 0}, {0, 0, 0, 0}}, 0x00FFFF},
-    // J piece
-    {{{0, 1, 0, 0}, {0, 1, 0, 0}, {1, 1, 0, 0}, {0, 0, 0, 0}}, 0x0000FF},
-    // T piece
-    {{{0, 1, 0, 0}, {1, 1, 1, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}}, 0x800080},
-    // L piece
-    {{{0, 1, 0, 0}, {0, 1, 0, 0}, {0, 1, 1, 0}, {0, 0, 0, 0}}, 0xFFA500},
-    // O piece
-    {{{1, 1, 0, 0}, {1, 1, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}}, 0xFFFF00},
-    // Z piece
-    {{{1, 1, 0, 0}, {0, 1, 1, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}}, 0xFF0000},
-    // S piece
-    {{{0, 1, 1, 0}, {1, 1, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}}, 0x00FF00}
-};
-
-Tetromino Tetris::held;
-Tile Tetris::board[TetrisConfig::BOARD_HEIGHT][TetrisConfig::BOARD_WIDTH] = {};
-GameState Tetris::state = STATE_START;
-uint32_t Tetris::time = 0;
-uint32_t Tetris::score = 0;
-uint32_t Tetris::full_lines = 0;
-uint32_t Tetris::level = 1;
-uint8_t Tetris::bag_pieces[7] = {};
-uint8_t Tetris::bag_size = 0;
-
-// Game timing
-static uint32_t frame_counter = 0;
-static uint32_t seconds_counter = 0;
-static uint32_t frames_per_drop = TetrisConfig::INITIAL_FRAMES_PER_DROP;
+static InputController input;
+
+static TetrisAi ai;
+static bool autoplay = false;
+static uint64_t ai_cycles = 0;
+static uint64_t ai_report_nodes = 0;
+static uint64_t ai_report_cycles = 0;
+
+// The HUD redraws every frame while it is shown, not only when the game changes
+static bool hud_visible = false;
+static bool hud_stale = false;
 
 static float ui_scale;
 static uint16_t block_size;
@@ -62,7 +51,7 @@ static uint32_t playfield_pixel_height;
 static uint32_t info_x;
 static uint16_t line_height;
 
-void Tetris::init() {
+void Tetris::init(const uint32_t seed, const RepeatConfig repeat) {
     ui_scale = static_cast<float>(framebuffer.height) / 480.0f;
     if (ui_scale < 1.0f) ui_scale = 1.0f;
 
@@ -81,329 +70,159 @@ void Tetris::init() {
     playfield_y = center_y - playfield_pixel_height / 2;
 
     info_x = playfield_x + playfield_pixel_width + border_width + 20 * ui_scale;
-}
-
-uint8_t next_piece_index = 0;
-
-void Tetris::new_piece() {
-    if (bag_size == 0) {
-        for (uint8_t i = 0; i < 7; i++) bag_pieces[i] = i;
-        for (uint32_t i = 6; i > 0; --i) {
-            const int j = rand() % (i + 1);
-            const uint8_t tmp = bag_pieces[i];
-            bag_pieces[i] = bag_pieces[j];
-            bag_pieces[j] = tmp;
-        }
-        bag_size = 7;
-    }
-
-    const uint8_t piece_index = bag_pieces[--bag_size];
 
-    // Make a COPY of the piece definition so rotation doesn't corrupt the original
-    held.def = PIECE_DEFS[piece_index];
-    held.x = 3;
-    held.y = 0;
+    engine.reset(seed);
+    sim_tick = 0;
 
-    // Store next piece index
-    next_piece_index = (bag_size > 0) ? bag_pieces[bag_size - 1] : 0;
+    input.configure(repeat);
+    recorder.begin(replay_buffer, sizeof(replay_buffer), seed, repeat);
+    recording = true;
 }
 
-bool Tetris::collides(uint8_t piece[PIECE_SIZE][PIECE_SIZE], const int8_t x, const int8_t y) {
-    for (uint8_t rel_y = 0; rel_y < PIECE_SIZE; rel_y++) {
-        for (uint8_t rel_x = 0; rel_x < PIECE_SIZE; rel_x++) {
-            if (piece[rel_y][rel_x] == 0) continue;
-
-            const int8_t abs_x = x + rel_x;
-            const int8_t abs_y = y + rel_y;
-
-            // Check bounds
-            if (abs_x < 0 || abs_x >= TetrisConfig::BOARD_WIDTH ||
-                abs_y >= TetrisConfig::BOARD_HEIGHT) {
-                return true;
-            }
-
-            // Check collision with placed blocks (ignore if above board)
-            if (abs_y >= 0 && board[abs_y][abs_x].color != 0) {
-                return true;
-            }
-        }
+bool Tetris::play_replay(const uint8_t* data, const size_t size, const bool fast) {
+    if (!playback.open(data, size)) {
+        logger.warn(FMT("Tetris: invalid replay log (%u bytes)"), size);
+        return false;
     }
 
-    return false;
-}
-
-void Tetris::move(const int8_t dir_x, const int8_t dir_y) {
-    const int8_t next_x = held.x + dir_x;
-    const int8_t next_y = held.y + dir_y;
-
-    if (collides(held.def.minos, next_x, next_y)) {
-        if (dir_y > 0) drop_piece();
-        return;
+    recording = false;
+    logger.info("Tetris: replaying log with seed %u", playback.get_seed());
+
+    if (fast) {
+        const uint64_t start = tsc::now_ns();
+        const ReplayResult result = replay_run(engine, playback);
+        const uint64_t elapsed_us = (tsc::now_ns() - start) / 1000;
+
+        sim_tick = result.ticks;
+        logger.info(
+            "Tetris: replayed %lu events over %lu ticks in %lu us, score %u",
+            result.events,
+            result.ticks,
+            elapsed_us,
+            engine.get_score()
+        );
+        return true;
     }
 
-    held.x = next_x;
-    held.y = next_y;
+    engine.reset(playback.get_seed());
+    input.reset();
+    input.configure(playback.get_repeat());
+    sim_tick = 0;
+    playing_back = true;
+    return true;
 }
 
-void Tetris::hard_drop() {
-    while (!collides(held.def.minos, held.x, held.y + 1)) {
-        held.y++;
-    }
-    drop_piece();
+void Tetris::set_autoplay(const bool enabled) {
+    autoplay = enabled;
+    logger.info("Tetris: autoplay %s", enabled ? "enabled" : "disabled");
 }
 
-static void compute_rotated(
-    uint8_t dst[PIECE_SIZE][PIECE_SIZE],
-    const uint8_t src[PIECE_SIZE][PIECE_SIZE],
-    const bool clockwise
-) {
-    for (uint8_t i = 0; i < PIECE_SIZE; i++) {
-        for (uint8_t j = 0; j < PIECE_SIZE; j++) {
-            if (clockwise) {
-                dst[j][PIECE_SIZE - 1 - i] = src[i][j];
-            } else {
-                dst[PIECE_SIZE - 1 - j][i] = src[i][j];
-            }
-        }
+static void autoplay_step(TetrisEngine& engine, const uint64_t tick) {
+    const uint64_t start = rdtsc();
+    const Action action = ai.next_action(engine);
+    ai_cycles += rdtsc() - start;
+
+    // Tap the key for the action like a player would, so that the move is
+    // recorded and a replay of the session reproduces it
+    KeyEvent ev = {};
+    if (action_to_key(action, ev.scancode)) {
+        if (recording) recorder.record(tick, ev);
+        input.key(engine, ev);
+        ev.break_key = true;
+        if (recording) recorder.record(tick, ev);
+        input.key(engine, ev);
     }
-}
-
-static int div_round(const int num, const int den) {
-    if (den == 0) return 0;
-    if (num >= 0) return (num + den / 2) / den;
-    return -((-num + den / 2) / den);
-}
-
-bool Tetris::rotate_piece(Tetromino&piece, const bool clockwise) {
-    uint8_t rotated[PIECE_SIZE][PIECE_SIZE] = {};
-    compute_rotated(rotated, piece.def.minos, clockwise);
-
-    int before_x = 0, before_y = 0;
-    int after_x = 0, after_y = 0;
-    int count = 0;
 
-    for (uint8_t i = 0; i < PIECE_SIZE; i++) {
-        for (uint8_t j = 0; j < PIECE_SIZE; j++) {
-            if (piece.def.minos[i][j]) {
-                before_x += j;
-                before_y += i;
-                count++;
-            }
-            if (rotated[i][j]) {
-                after_x += j;
-                after_y += i;
-            }
+    if (tick % AI_REPORT_TICKS == 0) {
+        const uint64_t nodes = ai.get_nodes() - ai_report_nodes;
+        const uint64_t cycles = ai_cycles - ai_report_cycles;
+        if (nodes) {
+            logger.debug(FMT("AI: %u nodes in %u cycles (%u cycles/node)"), nodes, cycles, cycles / nodes);
         }
+        ai_report_nodes = ai.get_nodes();
+        ai_report_cycles = ai_cycles;
     }
-
-    if (count == 0) return false;
-
-    // Offset to keep piece centered after rotation
-    const int dx = div_round(before_x - after_x, count);
-    const int dy = div_round(before_y - after_y, count);
-    const int8_t new_x = piece.x + dx;
-    const int8_t new_y = piece.y + dy;
-
-    if (collides(rotated, new_x, new_y)) {
-        return false;
-    }
-
-    memcpy(piece.def.minos, rotated, PIECE_SIZE * PIECE_SIZE);
-    piece.x = new_x;
-    piece.y = new_y;
-    return true;
-}
-
-void Tetris::rotate_cw() {
-    rotate_piece(held, true);
 }
 
-void Tetris::rotate_ccw() {
-    rotate_piece(held, false);
+void Tetris::dump_replay() {
+    serial::printf("replay: %zu bytes%s\n", recorder.size(), recorder.overflowed() ? " (truncated)" : "");
+    serial::write_hex(recorder.data(), recorder.size());
+    serial::print("replay: end\n");
 }
 
-void Tetris::drop_piece() {
-    // Lock piece into board
-    for (uint8_t rel_y = 0; rel_y < PIECE_SIZE; rel_y++) {
-        for (uint8_t rel_x = 0; rel_x < PIECE_SIZE; rel_x++) {
-            if (held.def.minos[rel_y][rel_x] == 0) continue;
-
-            const int8_t abs_x = held.x + rel_x;
-            const int8_t abs_y = held.y + rel_y;
-
-            if (abs_x < 0 || abs_x >= TetrisConfig::BOARD_WIDTH ||
-                abs_y < 0 || abs_y >= TetrisConfig::BOARD_HEIGHT) {
-                continue;
-            }
-
-            board[abs_y][abs_x].color = held.def.color;
-        }
-    }
-
-    check_row();
-    new_piece();
-
-    // Game over if new piece immediately collides
-    if (collides(held.def.minos, held.x, held.y+1)) {
-        state = STATE_GAME_OVER;
-    }
-}
-
-void Tetris::check_row() {
-    uint8_t lines_cleared = 0;
-
-    for (int16_t y = TetrisConfig::BOARD_HEIGHT - 1; y >= 0; y--) {
-        bool is_full = true;
-        bool is_empty = true;
-
-        for (uint8_t x = 0; x < TetrisConfig::BOARD_WIDTH; x++) {
-            if (board[y][x].color == 0) {
-                is_full = false;
-            } else {
-                is_empty = false;
-            }
+void Tetris::update() {
+    if (playing_back) {
+        KeyEvent ev;
+        while (!playback.done() && playback.next_tick() <= sim_tick && playback.next(ev)) {
+            apply_key(ev);
         }
 
-        if (is_empty) break;
-
-        if (is_full) {
-            // Shift all rows above down
-            for (int16_t y2 = y; y2 > 0; y2--) {
-                memcpy(board[y2], board[y2 - 1], sizeof(Tile) * TetrisConfig::BOARD_WIDTH);
-            }
-            memset(board[0], 0, sizeof(Tile) * TetrisConfig::BOARD_WIDTH);
-
-            y++; // Check this row again
-            full_lines++;
-            lines_cleared++;
+        if (playback.done()) {
+            playing_back = false;
+            logger.info(FMT("Tetris: replay finished after %u ticks"), sim_tick);
         }
     }
 
-    // Update level and speed
-    const uint32_t new_level = (full_lines / TetrisConfig::LINES_PER_LEVEL) + 1;
-    if (new_level > level) {
-        level = new_level;
-        frames_per_drop = TetrisConfig::INITIAL_FRAMES_PER_DROP - (level * 5);
-        if (frames_per_drop < TetrisConfig::MIN_FRAMES_PER_DROP) {
-            frames_per_drop = TetrisConfig::MIN_FRAMES_PER_DROP;
-        }
-    }
+    if (autoplay && !playing_back) autoplay_step(engine, sim_tick);
 
-    if (lines_cleared > 0 && lines_cleared <= 4) {
-        constexpr uint32_t line_scores[4] = {100, 300, 500, 800};
-        score += line_scores[lines_cleared - 1] * level;
-    }
+    input.tick(engine);
+    engine.tick();
+    sim_tick++;
+    hud_stale = hud_visible;
 }
 
-void Tetris::update() {
+void Tetris::render() {
+    frame_stats::enter(PHASE_CLEAR);
+    screen::clear();
+    frame_stats::enter(PHASE_DRAW);
     draw();
+    if (hud_visible) draw_hud(8, 8, ui_scale);
+    frame_stats::enter(PHASE_FLUSH);
+    screen::flush();
 
-    if (state != STATE_ACTIVE) return;
-
-    // Automatic piece drop
-    frame_counter++;
-    if (frame_counter >= frames_per_drop) {
-        move(0, 1);
-        frame_counter = 0;
-    }
+    drawn_revision = engine.get_revision();
+    hud_stale = false;
+}
 
-    // Time tracking
-    seconds_counter++;
-    if (seconds_counter >= TetrisConfig::FRAMES_PER_SECOND) {
-        time++;
-        seconds_counter = 0;
-    }
+bool Tetris::needs_redraw() {
+    return engine.get_revision() != drawn_revision || hud_stale;
 }
 
-void Tetris::handle_key(const KeyEvent ev) {
-    if (ev.break_key) return;
-
-    switch (ev.scancode) {
-        case KEY_X:
-        case KEY_W:
-        case KEY_ARROW_UP:
-            rotate_cw();
-            break;
-
-        case KEY_Z:
-        case KEY_CONTROL:
-            rotate_ccw();
-            break;
-
-        case KEY_S:
-        case KEY_ARROW_DOWN:
-            move(0, 1);
-            break;
-
-        case KEY_A:
-        case KEY_ARROW_LEFT:
-            move(-1, 0);
-            break;
-
-        case KEY_D:
-        case KEY_ARROW_RIGHT:
-            move(1, 0);
-            break;
-
-        case KEY_SPACE:
-            if (state == STATE_START) {
-                state = STATE_ACTIVE;
-                new_piece();
-            } else if (state == STATE_ACTIVE) {
-                hard_drop();
-            }
-            break;
-
-        case KEY_R:
-            restart();
-            break;
-
-        case KEY_ESCAPE:
-        case KEY_P:
-            if (state == STATE_ACTIVE) {
-                state = STATE_PAUSED;
-            } else if (state == STATE_PAUSED) {
-                state = STATE_ACTIVE;
-            }
-            break;
+bool Tetris::is_idle() {
+    return engine.get_state() != STATE_ACTIVE && !autoplay && !playing_back;
+}
 
-        default:
-            break;
+void Tetris::apply_key(const KeyEvent ev) {
+    if (input.key(engine, ev) == ACTION_RESTART) {
+        logger.info("Tetris: Restarting");
     }
 }
 
-static void draw_tile(const uint32_t x, const uint32_t y, const uint16_t size, const uint32_t color) {
-    if (size < 3) {
-        screen::draw_rect(x, y, size, size, color);
+void Tetris::handle_key(const KeyEvent ev) {
+    if (!ev.break_key && ev.scancode == KEY_F1) {
+        hud_visible = !hud_visible;
+        hud_stale = true;
         return;
     }
 
-    // Base color
-    screen::draw_rect(x, y, size, size, color);
+    // Live input is ignored while a replay is driving the game
+    if (playing_back) return;
 
-    const uint16_t inset = size / 8 + 1;
-
-    // Top highlight
-    const uint32_t highlight = lighten_color(color, 25);
-    const uint16_t hl_height = size / 3;
-    screen::draw_rect(x + inset, y + inset, size - inset * 2, hl_height, highlight);
+    if (!ev.break_key && ev.scancode == KEY_F12) {
+        dump_replay();
+        return;
+    }
 
-    // Left highlight
-    const uint32_t left_hl = lighten_color(color, 12);
-    const uint16_t left_width = size / 6;
-    screen::draw_rect(x + inset, y + inset + hl_height, left_width, size - inset * 2 - hl_height, left_hl);
+    if (!ev.break_key && ev.scancode == KEY_F2) {
+        set_autoplay(!autoplay);
+        return;
+    }
 
-    // Bottom shadow
-    const uint32_t shadow = darken_color(color, 30);
-    const uint16_t shadow_height = size / 3;
-    screen::draw_rect(x + inset, y + size - inset - shadow_height, size - inset * 2, shadow_height, shadow);
+    if (recording) recorder.record(sim_tick, ev);
 
-    // Outline
-    const uint32_t outline = darken_color(color, 45);
-    screen::draw_rect(x, y, size, 1, outline);
-    screen::draw_rect(x, y, 1, size, outline);
-    screen::draw_rect(x, y + size - 1, size, 1, outline);
-    screen::draw_rect(x + size - 1, y, 1, size, outline);
+    const uint32_t revision = engine.get_revision();
+    apply_key(ev);
+    if (engine.get_revision() != revision) latency::input(ev.timestamp);
 }
 
 static void draw_border() {
@@ -470,6 +289,8 @@ void Tetris::draw() {
     // Border
     draw_border();
 
+    const GameState state = engine.get_state();
+
     if (state == STATE_START) {
         screen::draw("Press [SPACE] to start", info_x, playfield_y, 1.3);
         return;
@@ -477,13 +298,13 @@ void Tetris::draw() {
 
     // Stats
     uint32_t info_y = playfield_y;
-    screen::draw(format("FULL LINES: %d", full_lines), info_x, info_y, 1.4);
+    screen::draw(StackString<32>("FULL LINES: %d", engine.get_full_lines()), info_x, info_y, 1.4);
     info_y += line_height;
-    screen::draw(format("LEVEL: %d", level), info_x, info_y, 1.4);
+    screen::draw(StackString<32>("LEVEL: %d", engine.get_level()), info_x, info_y, 1.4);
     info_y += line_height;
-    screen::draw(format("SCORE: %d", score), info_x, info_y, 1.4);
+    screen::draw(StackString<32>("SCORE: %d", engine.get_score()), info_x, info_y, 1.4);
     info_y += line_height;
-    screen::draw(format("TIME: %02d:%02d", time / 60, time % 60), info_x, info_y, 1.4);
+    screen::draw(StackString<32>("TIME: %02d:%02d", engine.get_time() / 60, engine.get_time() % 60), info_x, info_y, 1.4);
     info_y += line_height * 1.5;
 
     // Controls
@@ -492,21 +313,11 @@ void Tetris::draw() {
     screen::draw("[R]: Restart", info_x, info_y, 1.4);
     info_y += line_height;
 
-    // Draw board
-    for (uint8_t y = 0; y < TetrisConfig::BOARD_HEIGHT; y++) {
-        for (uint8_t x = 0; x < TetrisConfig::BOARD_WIDTH; x++) {
-            if (board[y][x].color == 0) continue;
-            const uint32_t px = playfield_x + x * block_size;
-            const uint32_t py = playfield_y + y * block_size;
-            draw_tile(px, py, block_size, board[y][x].color);
-        }
-    }
-
-    // Draw active piece
-    draw_piece(held.def, held.x, held.y);
+    // Draw board and active piece
+    draw_board(engine, playfield_x, playfield_y, block_size);
 
     // Draw next piece
-    draw_piece(PIECE_DEFS[next_piece_index], 14, 8);
+    draw_piece(PIECE_DEFS[engine.get_next_piece()], 14, 8);
 
     // Overlays
     if (state == STATE_GAME_OVER) {
@@ -515,18 +326,3 @@ void Tetris::draw() {
         draw_overlay("Paused", "[P] Resume");
     }
 }
-
-void Tetris::restart() {
-    logger.info("Tetris: Restarting");
-    state = STATE_START;
-    full_lines = 0;
-    score = 0;
-    level = 1;
-    time = 0;
-    frame_counter = 0;
-    seconds_counter = 0;
-    frames_per_drop = TetrisConfig::INITIAL_FRAMES_PER_DROP;
-    memset(board, 0, sizeof(board));
-    bag_size = 0;
-    new_piece();
-}
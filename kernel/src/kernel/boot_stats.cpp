@@ -0,0 +1,51 @@
+#include "kernel/boot_stats.hpp"
+
+#include "driver/tsc.hpp"
+#include "kernel/system.hpp"
+#include "lib/log.hpp"
+
+namespace boot_stats {
+    struct Phase {
+        const char* name;
+        uint64_t end; // TSC at the mark
+    };
+
+    static uint64_t start_tsc = 0;
+    static Phase phases[BOOT_STATS_MAX_PHASES];
+    static uint32_t phase_count = 0;
+    static bool reported = false;
+
+    void start() {
+        start_tsc = rdtsc();
+    }
+
+    void mark(const char* name) {
+        if (reported || phase_count == BOOT_STATS_MAX_PHASES) return;
+        phases[phase_count++] = {name, rdtsc()};
+    }
+
+    void report() {
+        if (reported) return;
+        reported = true;
+
+        if (tsc::get_frequency() == 0) {
+            logger.info("Boot: TSC not calibrated, no timings");
+            return;
+        }
+
+        const uint64_t total_ns = tsc::cycles_to_ns(rdtsc() - start_tsc);
+        logger.info(FMT("Boot: %u us from kmain to the first frame"), total_ns / 1000);
+
+        uint64_t previous = start_tsc;
+        for (uint32_t i = 0; i < phase_count; i++) {
+            const uint64_t ns = tsc::cycles_to_ns(phases[i].end - previous);
+            logger.info(
+                FMT("Boot:   %-16s %8u us %3u%%"),
+                phases[i].name,
+                ns / 1000,
+                total_ns ? ns * 100 / total_ns : 0
+            );
+            previous = phases[i].end;
+        }
+    }
+}
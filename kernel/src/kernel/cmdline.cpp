@@ -1,5 +1,122 @@
 #include "kernel/cmdline.hpp"
+#include "kernel/irq_bench.hpp"
+#include "kernel/profiler.hpp"
+#include "lib/string.hpp"
+#include "tetris/grid.hpp"
+#include "tetris/perft.hpp"
+
+static bool parse_uint(const char* str, uint32_t& out) {
+    if (!*str) return false;
+
+    uint32_t value = 0;
+    for (; *str; str++) {
+        if (*str < '0' || *str > '9') return false;
+        value = value * 10 + (*str - '0');
+    }
+
+    out = value;
+    return true;
+}
+
+/**
+ * Parse a duration in ms into simulation ticks, rounding to the nearest tick
+ */
+static bool parse_ticks(const char* str, uint8_t& out) {
+    uint32_t ms;
+    if (!parse_uint(str, ms)) return false;
+
+    const uint32_t ticks = (ms * TetrisConfig::FRAMES_PER_SECOND + 500) / 1000;
+    if (ticks > UINT8_MAX) return false;
+
+    out = ticks;
+    return true;
+}
+
+static void parse_option(const char* key, const char* value) {
+    if (strcmp(key, "replay") == 0) {
+        if (strcmp(value, "fast") == 0) {
+            config.replay_mode = REPLAY_FAST;
+        } else if (strcmp(value, "realtime") == 0 || strcmp(value, "") == 0) {
+            config.replay_mode = REPLAY_REALTIME;
+        } else {
+            logger.warn("cmdline: unknown replay mode '%s'", value);
+        }
+    } else if (strcmp(key, "autoplay") == 0) {
+        config.autoplay = true;
+    } else if (strcmp(key, "logsync") == 0) {
+        logger.set_sync(true);
+    } else if (strcmp(key, "perft") == 0) {
+        uint32_t depth;
+        if (parse_uint(value, depth) && depth <= PERFT_MAX_DEPTH) {
+            config.perft_depth = depth;
+        } else {
+            logger.warn("cmdline: perft depth must be 0-%d, got '%s'", PERFT_MAX_DEPTH, value);
+        }
+    } else if (strcmp(key, "grid") == 0) {
+        uint32_t count;
+        if (parse_uint(value, count) && count <= GRID_MAX_BOARDS) {
+            config.grid_boards = count;
+        } else {
+            logger.warn("cmdline: grid board count must be 0-%d, got '%s'", GRID_MAX_BOARDS, value);
+        }
+    } else if (strcmp(key, "das") == 0) {
+        if (!parse_ticks(value, config.repeat.das_ticks)) {
+            logger.warn("cmdline: das must be a delay in ms up to 2550, got '%s'", value);
+        }
+    } else if (strcmp(key, "arr") == 0) {
+        if (!parse_ticks(value, config.repeat.arr_ticks)) {
+            logger.warn("cmdline: arr must be an interval in ms up to 2550, got '%s'", value);
+        }
+    } else if (strcmp(key, "baud") == 0) {
+        if (!parse_uint(value, config.baud)) {
+            logger.warn("cmdline: baud must be a number, got '%s'", value);
+        }
+    } else if (strcmp(key, "prof") == 0) {
+        if (!parse_uint(value, config.profile_hz) || config.profile_hz > PROFILE_MAX_RATE) {
+            logger.warn("cmdline: prof must be a rate in Hz up to %d, got '%s'", PROFILE_MAX_RATE, value);
+            config.profile_hz = 0;
+        }
+    } else if (strcmp(key, "profcycles") == 0) {
+        if (!parse_uint(value, config.profile_cycles) || config.profile_cycles == 0) {
+            logger.warn("cmdline: profcycles must be a number of cycles, got '%s'", value);
+            config.profile_cycles = 0;
+        }
+    } else if (strcmp(key, "profstack") == 0) {
+        config.profile_stacks = true;
+    } else if (strcmp(key, "trace") == 0) {
+        config.trace = value;
+    } else if (strcmp(key, "irqbench") == 0) {
+        if (!*value) {
+            config.irq_bench = IRQ_BENCH_DEFAULT_ITERATIONS;
+        } else if (!parse_uint(value, config.irq_bench)) {
+            logger.warn("cmdline: irqbench must be a number of interrupts, got '%s'", value);
+            config.irq_bench = 0;
+        }
+    } else {
+        logger.warn("cmdline: unknown option '%s'", key);
+    }
+}
 
 void parse_cmdline(char* cmdline) {
     logger.info("Kernel cmdline=%s", cmdline);
-}
\ No newline at end of file
+    if (!cmdline) return;
+
+    char* p = cmdline;
+    while (*p) {
+        while (*p == ' ') p++;
+        if (!*p) break;
+
+        char* key = p;
+        const char* value = "";
+        while (*p && *p != ' ') {
+            if (*p == '=' && *value == '\0') {
+                *p = '\0';
+                value = p + 1;
+            }
+            p++;
+        }
+        if (*p) *p++ = '\0';
+
+        parse_option(key, value);
+    }
+}
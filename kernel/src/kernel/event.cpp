@@ -0,0 +1,33 @@
+#include "kernel/event.hpp"
+
+#include "driver/timer.hpp"
+#include "lib/ring.hpp"
+
+namespace events {
+    // Producers are interrupt handlers, which never nest, so on one CPU they
+    // count as a single producer for the main loop to consume from
+    static SpscRing<Event, EVENT_QUEUE_SIZE> queue;
+
+    bool post(const Event& ev) {
+        return queue.push(ev);
+    }
+
+    bool poll(Event& out) {
+        return queue.pop(out);
+    }
+
+    void wait(const uint64_t deadline_ns) {
+        // Check with interrupts off so an event posted just now can't be slept through
+        asm volatile("cli");
+        if (!queue.empty()) {
+            asm volatile("sti");
+            return;
+        }
+
+        timer::sleep_until(deadline_ns);
+    }
+
+    uint64_t get_dropped() {
+        return queue.get_dropped();
+    }
+}
@@ -0,0 +1,121 @@
+#include "kernel/frame_stats.hpp"
+
+#include "driver/tsc.hpp"
+#include "memory/mem.hpp"
+
+#define NS_PER_SECOND 1000000000ull
+
+namespace frame_stats {
+    static constexpr const char* phase_names[PHASE_COUNT] = {
+        "input", "sim", "clear", "draw", "flush", "idle"
+    };
+
+    static FramePhase current = PHASE_INPUT;
+    static uint64_t phase_start = 0;
+    static uint64_t last_frame = 0;
+
+    static uint32_t frame_us[FRAME_STATS_WINDOW];
+    static uint32_t frame_head = 0; // total frames recorded, the slot is frame_head % FRAME_STATS_WINDOW
+
+    // Totals for the second in progress
+    static uint64_t second_start = 0;
+    static uint32_t second_frames = 0;
+    static uint64_t phase_cycles[PHASE_COUNT];
+    static uint64_t phase_event_totals[PHASE_COUNT][PMU_EVENT_COUNT];
+    static PmuCounts last_events;
+    static uint64_t irq_base[IRQ_COUNT];
+
+    // The last full second
+    static uint32_t fps = 0;
+    static uint32_t phase_us[PHASE_COUNT];
+    static uint64_t phase_events[PHASE_COUNT][PMU_EVENT_COUNT];
+    static uint32_t irqs[IRQ_COUNT];
+
+    void enter(const FramePhase phase) {
+        const uint64_t now = tsc::now_cycles();
+        if (phase_start) phase_cycles[current] += now - phase_start;
+
+        if (pmu::is_available()) {
+            PmuCounts counts;
+            pmu::read(counts);
+            if (phase_start) {
+                for (uint32_t e = 0; e < PMU_EVENT_COUNT; e++) {
+                    phase_event_totals[current][e] += counts.values[e] - last_events.values[e];
+                }
+            }
+            last_events = counts;
+        }
+
+        current = phase;
+        phase_start = now;
+    }
+
+    static void publish(const uint64_t now_ns) {
+        const uint64_t elapsed = now_ns - second_start;
+        fps = static_cast<uint32_t>(second_frames * NS_PER_SECOND / elapsed);
+
+        for (uint32_t i = 0; i < PHASE_COUNT; i++) {
+            phase_us[i] = second_frames ? tsc::cycles_to_ns(phase_cycles[i] / second_frames) / 1000 : 0;
+            phase_cycles[i] = 0;
+            for (uint32_t e = 0; e < PMU_EVENT_COUNT; e++) {
+                phase_events[i][e] = second_frames ? phase_event_totals[i][e] / second_frames : 0;
+                phase_event_totals[i][e] = 0;
+            }
+        }
+
+        for (uint32_t irq = 0; irq < IRQ_COUNT; irq++) {
+            const uint64_t count = irq_count(irq);
+            irqs[irq] = static_cast<uint32_t>((count - irq_base[irq]) * NS_PER_SECOND / elapsed);
+            irq_base[irq] = count;
+        }
+
+        second_start = now_ns;
+        second_frames = 0;
+    }
+
+    void frame_presented() {
+        const uint64_t now = tsc::now_cycles();
+        if (last_frame) {
+            frame_us[frame_head % FRAME_STATS_WINDOW] = tsc::cycles_to_ns(now - last_frame) / 1000;
+            frame_head++;
+        }
+        last_frame = now;
+        second_frames++;
+
+        const uint64_t now_ns = tsc::now_ns();
+        if (!second_start) {
+            second_start = now_ns;
+        } else if (now_ns - second_start >= NS_PER_SECOND) {
+            publish(now_ns);
+        }
+    }
+
+    void get(FrameStats& stats) {
+        stats.frames = frame_head < FRAME_STATS_WINDOW ? frame_head : FRAME_STATS_WINDOW;
+
+        uint64_t total = 0;
+        stats.frame_min_us = stats.frames ? UINT32_MAX : 0;
+        stats.frame_max_us = 0;
+        for (uint32_t i = 0; i < stats.frames; i++) {
+            const uint32_t us = frame_us[(frame_head - stats.frames + i) % FRAME_STATS_WINDOW];
+            stats.frame_us[i] = us;
+            total += us;
+            if (us < stats.frame_min_us) stats.frame_min_us = us;
+            if (us > stats.frame_max_us) stats.frame_max_us = us;
+        }
+        stats.frame_avg_us = stats.frames ? total / stats.frames : 0;
+
+        stats.fps = fps;
+        for (uint32_t i = 0; i < PHASE_COUNT; i++) {
+            stats.phase_us[i] = phase_us[i];
+            for (uint32_t e = 0; e < PMU_EVENT_COUNT; e++) stats.phase_events[i][e] = phase_events[i][e];
+        }
+        for (uint32_t irq = 0; irq < IRQ_COUNT; irq++) stats.irqs[irq] = irqs[irq];
+
+        stats.heap_used = mem::get_heap_used();
+    }
+
+    const char* phase_name(const FramePhase phase) {
+        return phase < PHASE_COUNT ? phase_names[phase] : "?";
+    }
+}
@@ -0,0 +1,105 @@
+#include "kernel/irq_bench.hpp"
+
+#include "driver/pic.hpp"
+#include "kernel/idt.hpp"
+#include "kernel/system.hpp"
+#include "lib/log.hpp"
+
+#define IRQ_BENCH_WARMUP 64
+
+extern "C" void* irq_stub_table[];
+extern "C" void irq_stub_full_bench();
+
+namespace irq_bench {
+    struct Timing {
+        uint64_t min;
+        uint64_t total;
+
+        void add(const uint64_t cycles) {
+            if (cycles < min) min = cycles;
+            total += cycles;
+        }
+    };
+
+    struct Path {
+        Timing entry;     // from before `int` to the handler
+        Timing roundtrip; // from before `int` to after the iretq
+    };
+
+    static volatile uint64_t handler_tsc = 0;
+
+    static void bench_handler(regs*) {
+        handler_tsc = rdtsc();
+    }
+
+    template<uint8_t vector>
+    static void sample(Path& path) {
+        const uint64_t start = rdtsc();
+        asm volatile("int %0" : : "i"(static_cast<uint32_t>(vector)) : "memory");
+        const uint64_t end = rdtsc();
+
+        path.entry.add(handler_tsc - start);
+        path.roundtrip.add(end - start);
+    }
+
+    static void report(const char* name, const Path& path, const uint32_t iterations) {
+        logger.info(
+            FMT("IRQ bench: %-9s entry %u min %u avg, round trip %u min %u avg cycles"),
+            name,
+            path.entry.min,
+            path.entry.total / iterations,
+            path.roundtrip.min,
+            path.roundtrip.total / iterations
+        );
+    }
+
+    void run(const uint32_t iterations) {
+        if (iterations == 0) return;
+
+        irq_install_vector(IRQ_BENCH_VECTOR, bench_handler);
+        irq_install_vector(IRQ_BENCH_FULL_VECTOR, bench_handler);
+        idt_set_gate(IRQ_BENCH_FULL_VECTOR, reinterpret_cast<uint64_t>(irq_stub_full_bench), 0x8E);
+
+        // Software interrupts ignore IF, turning it off only keeps timer and
+        // device IRQs out of the samples
+        const uint64_t flags = irq_save();
+
+        Path warmup = {{UINT64_MAX, 0}, {UINT64_MAX, 0}};
+        for (uint32_t i = 0; i < IRQ_BENCH_WARMUP; i++) {
+            sample<IRQ_BENCH_VECTOR>(warmup);
+            sample<IRQ_BENCH_FULL_VECTOR>(warmup);
+        }
+
+        // Interleaved, so that anything slowing the CPU down hits both alike
+        Path lean = {{UINT64_MAX, 0}, {UINT64_MAX, 0}};
+        Path full = lean;
+        for (uint32_t i = 0; i < iterations; i++) {
+            sample<IRQ_BENCH_VECTOR>(lean);
+            sample<IRQ_BENCH_FULL_VECTOR>(full);
+        }
+
+        Timing overhead = {UINT64_MAX, 0};
+        for (uint32_t i = 0; i < iterations; i++) {
+            const uint64_t start = rdtsc();
+            overhead.add(rdtsc() - start);
+        }
+
+        irq_restore(flags);
+
+        idt_set_gate(
+            IRQ_BENCH_FULL_VECTOR,
+            reinterpret_cast<uint64_t>(irq_stub_table[IRQ_BENCH_FULL_VECTOR - IRQ_VECTOR_BASE]),
+            0x8E
+        );
+        irq_install_vector(IRQ_BENCH_VECTOR, nullptr);
+        irq_install_vector(IRQ_BENCH_FULL_VECTOR, nullptr);
+
+        logger.info(FMT("IRQ bench: %u interrupts per path, rdtsc pairs take %u cycles"), iterations, overhead.min);
+        report("lean", lean, iterations);
+        report("full save", full, iterations);
+        logger.info(
+            FMT("IRQ bench: the lean entry saves %d cycles per round trip on average"),
+            static_cast<int64_t>(full.roundtrip.total / iterations) - static_cast<int64_t>(lean.roundtrip.total / iterations)
+        );
+    }
+}
@@ -2,6 +2,7 @@
 #include "driver/limine/limine_requests.hpp"
 #include "lib/log.hpp"
 #include "kernel/system.hpp"
+#include "memory/paging.hpp"
 
 uacpi_status uacpi_kernel_get_rsdp(uacpi_phys_addr* out_rsdp_address) {
     if (!out_rsdp_address) return UACPI_STATUS_INVALID_ARGUMENT;
@@ -27,13 +28,9 @@ void* uacpi_kernel_map(const uacpi_phys_addr addr, const uacpi_size len) {
 
     auto phys = static_cast<uint64_t>(addr);
     if (phys >= hhdm) phys = phys - hhdm;
-    const uacpi_phys_addr phys_addr = phys;
 
-    const uacpi_phys_addr page = phys_addr & ~static_cast<uacpi_phys_addr>(0xFFFULL);
-    const size_t offset = phys_addr - page;
-
-    const uintptr_t virt_page = hhdm + page;
-    return reinterpret_cast<void*>(virt_page + offset);
+    // Tables can live outside the RAM ranges the HHDM covers
+    return paging::map_mmio(phys, len);
 }
 
 // ReSharper disable once CppParameterMayBeConstPtrOrRef
@@ -0,0 +1,88 @@
+#include "kernel/latency.hpp"
+
+#include "driver/tsc.hpp"
+#include "lib/log.hpp"
+
+// Values below 2^SUB_BITS are exact, above that each power of two is split
+// into 2^SUB_BITS buckets. Samples are clamped to 2^32 us.
+#define SUB_BITS    4
+#define SUB_COUNT   (1 << SUB_BITS)
+#define BUCKETS     ((32 - SUB_BITS + 1) * SUB_COUNT)
+#define MAX_PENDING 16
+
+namespace latency {
+    static uint32_t buckets[BUCKETS];
+    static uint32_t count = 0;
+    static uint64_t max_us = 0;
+
+    // Inputs waiting for the frame that shows them
+    static uint64_t pending[MAX_PENDING];
+    static uint8_t pending_count = 0;
+
+    static uint32_t bucket_of(uint64_t us) {
+        if (us >= (1ull << 32)) us = (1ull << 32) - 1;
+        if (us < SUB_COUNT) return us;
+
+        const uint32_t msb = 63 - __builtin_clzll(us);
+        const uint32_t shift = msb - SUB_BITS;
+        return (shift + 1) * SUB_COUNT + ((us >> shift) & (SUB_COUNT - 1));
+    }
+
+    // Largest value that falls in a bucket
+    static uint64_t bucket_limit(const uint32_t bucket) {
+        if (bucket < SUB_COUNT) return bucket;
+
+        const uint32_t shift = bucket / SUB_COUNT - 1;
+        const uint64_t low = static_cast<uint64_t>(SUB_COUNT + bucket % SUB_COUNT) << shift;
+        return low + (1ull << shift) - 1;
+    }
+
+    static uint64_t percentile(const uint32_t pct) {
+        if (count == 0) return 0;
+
+        const uint64_t rank = (static_cast<uint64_t>(count) * pct + 99) / 100;
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < BUCKETS; i++) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                const uint64_t limit = bucket_limit(i);
+                return limit < max_us ? limit : max_us;
+            }
+        }
+        return max_us;
+    }
+
+    void input(const uint64_t timestamp_ns) {
+        if (!timestamp_ns || pending_count == MAX_PENDING) return;
+        pending[pending_count++] = timestamp_ns;
+    }
+
+    void frame_presented() {
+        if (!pending_count) return;
+
+        const uint64_t now = tsc::now_ns();
+        for (uint8_t i = 0; i < pending_count; i++) {
+            const uint64_t us = now > pending[i] ? (now - pending[i]) / 1000 : 0;
+            buckets[bucket_of(us)]++;
+            if (us > max_us) max_us = us;
+            count++;
+            if (count % LATENCY_REPORT_SAMPLES == 0) report();
+        }
+        pending_count = 0;
+    }
+
+    LatencyStats get_stats() {
+        return {count, percentile(50), percentile(99), max_us};
+    }
+
+    void report() {
+        const LatencyStats stats = get_stats();
+        logger.info(
+            "Latency: %u inputs, p50 %lu us, p99 %lu us, max %lu us",
+            stats.count,
+            stats.p50_us,
+            stats.p99_us,
+            stats.max_us
+        );
+    }
+}
@@ -1,22 +1,105 @@
 #include "driver/acpi.hpp"
 #include "driver/apic.hpp"
 #include "driver/cmos.hpp"
+#include "driver/hpet.hpp"
 #include "driver/pic.hpp"
+#include "driver/pm_timer.hpp"
+#include "driver/pmu.hpp"
 #include "driver/ps2/keyboard.hpp"
 #include "driver/screen.hpp"
 #include "driver/serial.hpp"
 #include "driver/timer.hpp"
+#include "driver/tsc.hpp"
 #include "driver/limine/limine_requests.hpp"
 #include "driver/ps2/ps2.hpp"
+#include "kernel/boot_stats.hpp"
 #include "kernel/cmdline.hpp"
+#include "kernel/event.hpp"
+#include "kernel/frame_stats.hpp"
 #include "kernel/gdt.hpp"
 #include "kernel/idt.hpp"
+#include "kernel/irq_bench.hpp"
+#include "kernel/profiler.hpp"
+#include "kernel/timer_wheel.hpp"
+#include "kernel/trace.hpp"
 #include "lib/log.hpp"
 #include "lib/rand.hpp"
+#include "lib/string.hpp"
+#include "tetris/grid.hpp"
+#include "tetris/input.hpp"
+#include "tetris/perft.hpp"
 #include "tetris/tetris.hpp"
 
+#define FRAME_NS 10000000 // 100 FPS
+
+static const limine_file* find_module(const char* string) {
+    const limine_module_response* response = limine_requests::module_request.response;
+    if (!response) return nullptr;
+
+    for (uint64_t i = 0; i < response->module_count; i++) {
+        const limine_file* module = response->modules[i];
+        if (strcmp(module->string, string) == 0) return module;
+    }
+
+    return nullptr;
+}
+
+static void dispatch_event(const Event& ev) {
+    switch (ev.type) {
+        case EVENT_KEY:
+            if (!ev.key.break_key && ev.key.scancode == KEY_F3) {
+                profiler::dump();
+            } else if (!ev.key.break_key && ev.key.scancode == KEY_F4) {
+                trace::dump();
+            } else if (!config.grid_boards) {
+                Tetris::handle_key(ev.key);
+            }
+            break;
+
+        case EVENT_TIMER:
+            timer_wheel::dispatch(*ev.timer);
+            break;
+
+        case EVENT_SERIAL: {
+            // A terminal only sends characters, so press and release the matching key
+            if (ev.serial.value == PROFILE_DUMP_CHAR) {
+                profiler::dump();
+                break;
+            }
+            if (ev.serial.value == TRACE_DUMP_CHAR) {
+                trace::dump();
+                break;
+            }
+
+            KeyEvent key = {};
+            if (config.grid_boards || !char_to_key(ev.serial.value, key.scancode)) break;
+            key.timestamp = ev.serial.timestamp;
+            Tetris::handle_key(key);
+            key.break_key = true;
+            Tetris::handle_key(key);
+            break;
+        }
+    }
+}
+
+static void run_perft(const uint8_t max_depth) {
+    uint8_t queue[PERFT_MAX_DEPTH];
+    const int queue_len = perft_parse_queue("TIOLJSZ", queue, PERFT_MAX_DEPTH);
+    const TetrisEngine engine;
+
+    for (uint8_t depth = 1; depth <= max_depth && depth <= queue_len; depth++) {
+        const uint64_t start = tsc::now_ns();
+        const uint64_t nodes = perft(engine, queue, depth);
+        const uint64_t us = (tsc::now_ns() - start) / 1000;
+
+        logger.info(FMT("perft depth %d: %u nodes in %u us (%u nodes/s)"), depth, nodes, us, us ? nodes * 1000000 / us : 0);
+    }
+}
+
 extern "C" [[noreturn]] void kmain() {
+    boot_stats::start();
     serial::init();
+    boot_stats::mark("serial");
 
     if (!LIMINE_BASE_REVISION_SUPPORTED(limine_requests::limine_base_revision)) {
         panic("Unsupported base revision");
@@ -31,8 +114,13 @@ extern "C" [[noreturn]] void kmain() {
 
     fb_init(limine_framebuffer);
     logger.debug("Framebuffer initialized");
+    boot_stats::mark("framebuffer");
 
     parse_cmdline(limine_requests::executable_cmdline_request.response->cmdline);
+    if (config.baud && !serial::set_baud(config.baud)) {
+        logger.warn("Serial: unsupported baud rate %u", config.baud);
+    }
+    boot_stats::mark("cmdline");
 
     logger.info("Initializing kernel...");
 
@@ -44,41 +132,96 @@ extern "C" [[noreturn]] void kmain() {
 
     pic::init();
     logger.info("IRQ initialized");
+    boot_stats::mark("gdt, idt, pic");
 
     // mem::init_pmm();
     // logger.info("Phyiscal memory manager initialized");
     //
     // paging::init();
     // logger.info("Paging initialized");
-    //
-    // apic::init();
-    // logger.info("APIC initialized");
 
+    // Only the tables are read here, the HPET and the MADT need them next.
+    // PCI is not enumerated at all.
     acpi::init();
     logger.info("ACPI tables initialized");
+    boot_stats::mark("acpi");
 
     timer::init(100); // 100 times per second
     logger.info("PIC Timer initialized");
 
+    if (!hpet::init()) pm_timer::init();
+    boot_stats::mark("hpet, pm timer");
+    if (tsc::init()) logger.info("TSC clock initialized");
+    boot_stats::mark("tsc");
+
+    apic::init();
+    logger.info("APIC initialized");
+
+    pmu::init();
+
     asm volatile("sti");
     logger.info("Interrupts enabled");
 
-    // apic::apic_start_timer();
+    apic::apic_start_timer();
+    timer::stop_tick();
+    boot_stats::mark("apic, timers");
 
-    ps2::init();
-    logger.info("PS/2 controller initialized");
+    if (ps2::init()) {
+        logger.info("PS/2 controller initialized");
+        kb_init();
+        logger.info("PS/2 Keyboard initialized");
+    } else {
+        logger.warn("PS/2: no working controller, only serial input is available");
+    }
+    boot_stats::mark("ps/2");
 
-    kb_init();
-    logger.info("PS/2 Keyboard initialized");
+    serial::enable_irq();
 
     logger.info("Ready!");
 
     uint64_t seed = get_time();
-    logger.debug("Seeding RNG with time: %llu", seed);
+    logger.debug(FMT("Seeding RNG with time: %u"), seed);
     srand(seed);
 
-    kb_register_listener(Tetris::handle_key);
-    Tetris::init();
+    if (config.trace && !*config.trace) {
+        trace::set_enabled(true);
+    } else if (config.trace && !trace::set_enabled(config.trace, true)) {
+        logger.warn("trace: no tracepoint named '%s'", config.trace);
+    }
+    if (config.profile_cycles && !profiler::start_events(PMU_CYCLES, config.profile_cycles, config.profile_stacks)) {
+        logger.warn("Profiler: cannot sample on PMU cycles, using the timer");
+        if (!config.profile_hz) config.profile_hz = PROFILE_MAX_RATE;
+        config.profile_cycles = 0;
+    }
+    if (config.profile_hz && !config.profile_cycles) profiler::start(config.profile_hz, config.profile_stacks);
+    if (config.perft_depth) run_perft(config.perft_depth);
+    if (config.irq_bench) irq_bench::run(config.irq_bench);
+    boot_stats::mark("profiler, benchmarks");
+
+    const limine_file* replay = config.replay_mode != REPLAY_OFF ? find_module("replay") : nullptr;
+    if (config.replay_mode != REPLAY_OFF && !replay) {
+        logger.warn("Replay requested but no replay module was loaded");
+    }
+
+    if (config.grid_boards) {
+        TetrisGrid::init(
+            config.grid_boards,
+            seed,
+            replay ? static_cast<const uint8_t*>(replay->address) : nullptr,
+            replay ? replay->size : 0
+        );
+    } else {
+        Tetris::init(seed, config.repeat);
+        if (config.autoplay) Tetris::set_autoplay(true);
+
+        if (replay) {
+            Tetris::play_replay(
+                static_cast<const uint8_t*>(replay->address),
+                replay->size,
+                config.replay_mode == REPLAY_FAST
+            );
+        }
+    }
 
     // logger.info("Starting PCI bus enumeration");
     // pci::enumerate_busses();
@@ -86,34 +229,55 @@ extern "C" [[noreturn]] void kmain() {
 
     logger.debug("Entering main loop");
 
-    // Event-driven main loop using APIC timer ticks
-    // uint64_t last_tick = timer::get_ticks();
-    // constexpr uint64_t MAX_TICK_PROCESS = 8; // cap to avoid spiral of death
+    // The game owns the screen from here on, the log only goes to serial
+    logger.flush();
+    logger.set_console(false);
+
+    // Sleep until the next input event or frame deadline, the PIT tick is
+    // stopped when the APIC timer is available. While the game is idle there is
+    // no deadline and only input wakes the CPU.
+    uint64_t next_frame = tsc::now_ns();
+    boot_stats::mark("game init");
 
     for (;;) {
-        kb_process_queue();
-        screen::clear();
-        Tetris::update();
-        screen::flush();
-        timer::wait_ms(10); // ~100 FPS
-        // // Handle timer ticks (process accumulated ticks)
-        // const uint64_t now = timer::get_ticks();
-        //
-        // if (now != last_tick) {
-        //     uint64_t delta = now - last_tick;
-        //     if (delta > MAX_TICK_PROCESS) delta = MAX_TICK_PROCESS;
-        //
-        //     for (uint64_t i = 0; i < delta; ++i) {
-        //         Tetris::update();
-        //     }
-        //
-        //     last_tick += delta;
-        //
-        //     // redraw after processing
-        //     screen::flush();
-        // } else {
-        //     // No new tick: wait for next tick or interrupt (keyboard)
-        //     timer::wait_for_tick(last_tick);
-        // }
+        Event ev;
+        frame_stats::enter(PHASE_INPUT);
+        TRACE_BEGIN("events");
+        while (events::poll(ev)) dispatch_event(ev);
+        logger.flush();
+        trace::pump();
+        TRACE_END("events");
+
+        const bool idle = !config.grid_boards && Tetris::is_idle();
+        const uint64_t now = tsc::now_ns();
+        if (!idle && now >= next_frame) {
+            frame_stats::enter(PHASE_SIM);
+            TRACE_BEGIN("tick");
+            if (config.grid_boards) {
+                TetrisGrid::update();
+            } else {
+                Tetris::update();
+            }
+            TRACE_END("tick");
+
+            // Drop frames that were missed instead of running them back to back
+            next_frame += FRAME_NS;
+            if (next_frame <= now) next_frame = now + FRAME_NS;
+        }
+
+        if (!config.grid_boards && Tetris::needs_redraw()) {
+            TRACE_BEGIN("render");
+            Tetris::render();
+            TRACE_END("render");
+        }
+
+        // Everything up to here ran once before the first frame
+        boot_stats::mark("first frame");
+        boot_stats::report();
+
+        frame_stats::enter(PHASE_IDLE);
+        TRACE_BEGIN("idle");
+        events::wait(idle ? EVENT_WAIT_FOREVER : next_frame);
+        TRACE_END("idle");
     }
 }
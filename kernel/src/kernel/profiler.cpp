@@ -0,0 +1,169 @@
+#include "kernel/profiler.hpp"
+
+#include "driver/pic.hpp"
+#include "driver/serial.hpp"
+#include "kernel/system.hpp"
+#include "kernel/timer_wheel.hpp"
+#include "lib/log.hpp"
+
+#define PROFILE_FORMAT_VERSION 1
+#define KERNEL_TEXT_BASE       0xFFFFFFFF80000000ull
+#define STACK_WALK_LIMIT       (64 * 1024) // frames further than this above rsp are not trusted
+
+namespace profiler {
+    // Each sample is a word holding its frame count followed by the frames,
+    // the interrupted rip first and then return addresses towards the root
+    static uint64_t buffer[PROFILE_BUFFER_WORDS];
+    static uint32_t used = 0;
+    static uint32_t samples = 0;
+    static uint64_t dropped = 0;
+
+    static Timer sample_timer;
+    static uint32_t period_ms = 0; // 0 when sampling on PMU events
+    static bool walk_stacks = false;
+    static bool running = false;
+    static volatile bool paused = false; // set while dumping, samples are discarded
+
+    // Follow the rbp chain of the interrupted code. Every frame must lie
+    // above the previous one and within reach of the interrupted rsp, so a
+    // function that does not keep a frame pointer ends the walk instead of
+    // sending it through arbitrary memory.
+    static uint32_t walk(const regs& r, uint64_t* frames, const uint32_t max) {
+        uint32_t n = 0;
+        frames[n++] = r.rip;
+        if (!walk_stacks) return n;
+
+        uint64_t fp = r.rbp;
+        while (n < max && fp >= r.rsp && fp + 16 <= r.rsp + STACK_WALK_LIMIT && (fp & 7) == 0) {
+            const auto frame = reinterpret_cast<const uint64_t*>(fp);
+            if (frame[1] < KERNEL_TEXT_BASE) break;
+            frames[n++] = frame[1];
+            if (frame[0] <= fp) break;
+            fp = frame[0];
+        }
+        return n;
+    }
+
+    static void take_sample(void*) {
+        const regs* r = irq_regs();
+        if (!r || paused) return;
+
+        uint64_t frames[PROFILE_MAX_DEPTH];
+        const uint32_t n = walk(*r, frames, PROFILE_MAX_DEPTH);
+        if (used + 1 + n > PROFILE_BUFFER_WORDS) {
+            dropped++;
+            return;
+        }
+
+        buffer[used++] = n;
+        for (uint32_t i = 0; i < n; i++) buffer[used++] = frames[i];
+        samples++;
+    }
+
+    void start(uint32_t rate_hz, const bool stacks) {
+        if (rate_hz == 0) rate_hz = 1;
+        if (rate_hz > PROFILE_MAX_RATE) rate_hz = PROFILE_MAX_RATE;
+
+        period_ms = 1000 / rate_hz;
+        walk_stacks = stacks;
+        running = true;
+
+        timer_wheel::setup(sample_timer, take_sample, nullptr, false);
+        timer_wheel::add(sample_timer, period_ms, period_ms);
+        logger.info("Profiler: sampling every %u ms%s", period_ms, stacks ? " with stacks" : "");
+    }
+
+    static void take_event_sample(regs*) {
+        take_sample(nullptr);
+    }
+
+    bool start_events(const PmuEvent event, const uint64_t period, const bool stacks) {
+        walk_stacks = stacks;
+        if (!pmu::start_sampling(event, period, take_event_sample)) return false;
+
+        period_ms = 0;
+        running = true;
+        logger.info("Profiler: sampling every %lu %s%s", period, pmu::event_name(event), stacks ? " with stacks" : "");
+        return true;
+    }
+
+    void stop() {
+        if (period_ms) {
+            timer_wheel::cancel(sample_timer);
+        } else {
+            pmu::stop_sampling();
+        }
+        running = false;
+    }
+
+    bool is_running() {
+        return running;
+    }
+
+    // Bytes are collected into hex lines, like replay dumps
+    static uint8_t line[SERIAL_HEX_LINE_BYTES];
+    static uint32_t line_len = 0;
+    static uint64_t dumped_bytes = 0;
+
+    static void flush_line() {
+        serial::write_hex(line, line_len);
+        line_len = 0;
+    }
+
+    static void put_byte(const uint8_t byte) {
+        line[line_len++] = byte;
+        dumped_bytes++;
+        if (line_len == SERIAL_HEX_LINE_BYTES) flush_line();
+    }
+
+    static void put_varint(uint64_t value) {
+        while (value >= 0x80) {
+            put_byte(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+        put_byte(static_cast<uint8_t>(value));
+    }
+
+    /**
+     * Format, all integers LEB128 varints:
+     *   version, period in ms (0 for PMU events), sample count, dropped count
+     *   per sample: frame count, then each frame as the zig-zag encoded
+     *   difference from the same frame of the previous sample (or from 0)
+     * Consecutive samples mostly share their callers, which makes those
+     * frames a single zero byte.
+     */
+    void dump() {
+        paused = true;
+
+        if (period_ms) {
+            serial::printf("profile: %u samples every %u ms, %lu dropped\n", samples, period_ms, dropped);
+        } else {
+            serial::printf("profile: %u samples on PMU events, %lu dropped\n", samples, dropped);
+        }
+
+        dumped_bytes = 0;
+        put_varint(PROFILE_FORMAT_VERSION);
+        put_varint(period_ms);
+        put_varint(samples);
+        put_varint(dropped);
+
+        uint64_t previous[PROFILE_MAX_DEPTH] = {};
+        for (uint32_t pos = 0; pos < used;) {
+            const uint32_t n = buffer[pos++];
+            put_varint(n);
+            for (uint32_t i = 0; i < n; i++) {
+                const uint64_t frame = buffer[pos++];
+                const int64_t delta = static_cast<int64_t>(frame - previous[i]);
+                put_varint(static_cast<uint64_t>(delta) << 1 ^ static_cast<uint64_t>(delta >> 63));
+                previous[i] = frame;
+            }
+        }
+        if (line_len) flush_line();
+
+        serial::printf("profile: end (%lu bytes)\n", dumped_bytes);
+
+        used = samples = 0;
+        dropped = 0;
+        paused = false;
+    }
+}
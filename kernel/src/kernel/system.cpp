@@ -4,6 +4,7 @@
 #include <lib/format.hpp>
 
 #include "driver/screen.hpp"
+#include "driver/serial.hpp"
 #include "lib/log.hpp"
 
 // read from b
@@ -27,7 +28,29 @@ void outl(uint16_t port, uint32_t data) {
     asm volatile("outl %1, %0" : : "dN" (port), "a" (data));
 }
 
+uint64_t rdtsc() {
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+    return (static_cast<uint64_t>(hi) << 32) | lo;
+}
+
+uint64_t rdmsr(const uint32_t msr) {
+    uint32_t lo, hi;
+    asm volatile("rdmsr" : "=a" (lo), "=d" (hi) : "c" (msr));
+    return (static_cast<uint64_t>(hi) << 32) | lo;
+}
+
+void wrmsr(const uint32_t msr, const uint64_t value) {
+    asm volatile("wrmsr" : : "c" (msr), "a" (static_cast<uint32_t>(value)), "d" (static_cast<uint32_t>(value >> 32)));
+}
+
+void cpuid(const uint32_t leaf, const uint32_t subleaf, uint32_t& eax, uint32_t& ebx, uint32_t& ecx, uint32_t& edx) {
+    asm volatile("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (leaf), "c" (subleaf));
+}
+
 void panic(const char* msg, ...) {
+    serial::sync();
+
     va_list ap;
     va_start(ap, msg);
     const char* formatted = vformat(msg, ap);
@@ -0,0 +1,227 @@
+#include "kernel/timer_wheel.hpp"
+
+#include "driver/tsc.hpp"
+#include "kernel/event.hpp"
+#include "kernel/system.hpp"
+
+// 4 levels of 64 slots cover 2^24 ms (about 4.6 hours), later timers are clamped
+#define LEVELS      4
+#define SLOT_BITS   6
+#define SLOTS       (1 << SLOT_BITS)
+#define SLOT_MASK   (SLOTS - 1)
+#define MAX_DELTA   ((1ull << (LEVELS * SLOT_BITS)) - 1)
+#define EXPIRING    LEVELS // Timer::level of a timer on the expiring list
+
+namespace timer_wheel {
+    static Timer* wheel[LEVELS][SLOTS];
+    static uint64_t occupied[LEVELS]; // bit n is set if slot n is non-empty
+    static uint64_t current = 0;      // next tick to process
+    static bool started = false;
+    static uint32_t pending_count = 0;
+    // The slot advance() is running, moved aside so that timers re-linked by
+    // their callbacks can't land back in it, but still unlinked by cancel()
+    static Timer* expiring = nullptr;
+
+    static void link(Timer& timer) {
+        uint64_t delta = timer.expires > current ? timer.expires - current : 0;
+        if (delta > MAX_DELTA) {
+            delta = MAX_DELTA;
+            timer.expires = current + MAX_DELTA;
+        }
+
+        uint8_t level = 0;
+        while (level < LEVELS - 1 && delta >= (1ull << ((level + 1) * SLOT_BITS))) level++;
+
+        const uint64_t when = delta == 0 ? current : timer.expires;
+        const uint8_t slot = (when >> (level * SLOT_BITS)) & SLOT_MASK;
+
+        timer.level = level;
+        timer.slot = slot;
+        timer.prev = nullptr;
+        timer.next = wheel[level][slot];
+        if (timer.next) timer.next->prev = &timer;
+        wheel[level][slot] = &timer;
+        occupied[level] |= 1ull << slot;
+
+        timer.pending = true;
+        pending_count++;
+    }
+
+    static void unlink(Timer& timer) {
+        if (timer.prev) {
+            timer.prev->next = timer.next;
+        } else if (timer.level == EXPIRING) {
+            expiring = timer.next;
+        } else {
+            wheel[timer.level][timer.slot] = timer.next;
+            if (!timer.next) occupied[timer.level] &= ~(1ull << timer.slot);
+        }
+        if (timer.next) timer.next->prev = timer.prev;
+
+        timer.next = timer.prev = nullptr;
+        timer.pending = false;
+        pending_count--;
+    }
+
+    void setup(Timer& timer, const timer_callback callback, void* data, const bool deferred) {
+        timer.callback = callback;
+        timer.data = data;
+        timer.deferred = deferred;
+    }
+
+    static uint64_t now_ms() {
+        return tsc::now_ns() / 1000000;
+    }
+
+    void add(Timer& timer, const uint32_t delay_ms, const uint32_t period_ms, const uint32_t slack_ms) {
+        const uint64_t flags = irq_save();
+
+        if (timer.pending) unlink(timer);
+        // Nothing advances an empty wheel when the tick is off, so catch it up
+        // before linking relative to it
+        if (!started || pending_count == 0) {
+            current = now_ms();
+            started = true;
+        }
+
+        uint64_t expires = now_ms() + delay_ms;
+        if (slack_ms) {
+            // Round up to the largest power of two within the slack
+            const uint64_t granularity = 1ull << (63 - __builtin_clzll(slack_ms));
+            expires = (expires + granularity - 1) & ~(granularity - 1);
+        }
+
+        timer.expires = expires;
+        timer.period = period_ms;
+        link(timer);
+
+        irq_restore(flags);
+    }
+
+    bool cancel(Timer& timer) {
+        const uint64_t flags = irq_save();
+        const bool was_pending = timer.pending || timer.deferred_queued;
+        if (timer.pending) unlink(timer);
+        // Its EVENT_TIMER stays queued, dispatch() skips it
+        timer.deferred_queued = false;
+        irq_restore(flags);
+        return was_pending;
+    }
+
+    /**
+     * Re-insert every timer of an outer slot, moving it closer to level 0
+     */
+    static void cascade(const uint8_t level, const uint8_t slot) {
+        Timer* timer = wheel[level][slot];
+        wheel[level][slot] = nullptr;
+        occupied[level] &= ~(1ull << slot);
+
+        while (timer) {
+            Timer* next = timer->next;
+            pending_count--;
+            link(*timer);
+            timer = next;
+        }
+    }
+
+    static void expire(Timer& timer) {
+        if (timer.period) {
+            timer.expires += timer.period;
+            link(timer);
+        }
+
+        if (!timer.deferred) {
+            timer.callback(timer.data);
+            return;
+        }
+
+        // A deferred timer that fires again before the main loop gets to it still runs once
+        if (timer.deferred_queued) return;
+
+        Event ev = {};
+        ev.type = EVENT_TIMER;
+        ev.timer = &timer;
+        timer.deferred_queued = events::post(ev);
+    }
+
+    void advance(const uint64_t now) {
+        if (!started) return;
+
+        while (current <= now) {
+            if (pending_count == 0) {
+                current = now + 1;
+                break;
+            }
+
+            // Skip straight to the next occupied slot or wrap of level 0
+            if (!occupied[0] && (current & SLOT_MASK) != 0) {
+                const uint64_t wrap = (current | SLOT_MASK) + 1;
+                if (wrap > now) {
+                    current = now + 1;
+                    break;
+                }
+                current = wrap;
+            }
+
+            const uint8_t index = current & SLOT_MASK;
+
+            // Every time a level wraps, pull the next slot of the level above down
+            for (uint8_t level = 1; level < LEVELS; level++) {
+                if (((current >> ((level - 1) * SLOT_BITS)) & SLOT_MASK) != 0) break;
+                cascade(level, (current >> (level * SLOT_BITS)) & SLOT_MASK);
+            }
+
+            expiring = wheel[0][index];
+            wheel[0][index] = nullptr;
+            occupied[0] &= ~(1ull << index);
+            for (Timer* timer = expiring; timer; timer = timer->next) timer->level = EXPIRING;
+            current++;
+
+            // One at a time, as a callback may cancel or re-add a timer further down
+            while (Timer* timer = expiring) {
+                unlink(*timer);
+                expire(*timer);
+            }
+        }
+    }
+
+    void dispatch(Timer& timer) {
+        // Cancelled after its event was queued
+        const uint64_t flags = irq_save();
+        const bool queued = timer.deferred_queued;
+        // Cleared first so a run that fires during the callback is queued again
+        timer.deferred_queued = false;
+        irq_restore(flags);
+        if (!queued) return;
+
+        timer.callback(timer.data);
+    }
+
+    static uint64_t slot_start(const uint8_t level, const uint64_t distance) {
+        return ((current >> (level * SLOT_BITS)) + distance) << (level * SLOT_BITS);
+    }
+
+    uint64_t next_expiry() {
+        const uint64_t flags = irq_save();
+        uint64_t earliest = TIMER_WHEEL_NONE;
+
+        for (uint8_t level = 0; level < LEVELS; level++) {
+            if (!occupied[level]) continue;
+
+            // The slot at current's index has only been cascaded once the levels below have wrapped
+            const bool cascaded = (current & ((1ull << (level * SLOT_BITS)) - 1)) != 0;
+            const uint8_t from = ((current >> (level * SLOT_BITS)) + cascaded) & SLOT_MASK;
+            const uint64_t rotated = (occupied[level] >> from) | (from ? occupied[level] << (SLOTS - from) : 0);
+
+            const uint64_t when = slot_start(level, __builtin_ctzll(rotated) + cascaded);
+            if (when < earliest) earliest = when;
+        }
+
+        irq_restore(flags);
+        return earliest;
+    }
+
+    uint32_t get_pending_count() {
+        return pending_count;
+    }
+}
@@ -0,0 +1,190 @@
+#include "kernel/trace.hpp"
+
+#include "driver/serial.hpp"
+#include "driver/tsc.hpp"
+#include "kernel/system.hpp"
+#include "lib/string.hpp"
+#include "memory/mem.hpp"
+
+#define TRACE_FORMAT_VERSION 1
+#define CR0_WP               (1ull << 16)
+#define JMP_REL32            0xE9
+// Records written per pump(), and the hex they take: 32 bytes a line
+#define TRACE_DUMP_CHUNK     64
+#define TRACE_DUMP_CHUNK_HEX (TRACE_DUMP_CHUNK * sizeof(TraceRecord) / SERIAL_HEX_LINE_BYTES * (SERIAL_HEX_LINE_BYTES * 2 + 1))
+
+// Bounds of the trace_points and __tracepoints sections, from the linker script
+extern "C" const TracePoint __start_trace_points[];
+extern "C" const TracePoint __stop_trace_points[];
+extern "C" const TraceJump __start___tracepoints[];
+extern "C" const TraceJump __stop___tracepoints[];
+
+struct TraceRing {
+    TraceRecord records[TRACE_RING_SIZE];
+    uint32_t head; // total records written, the slot is head % TRACE_RING_SIZE
+};
+
+struct TraceHeader {
+    uint32_t version;
+    uint32_t cpus;
+    uint64_t tsc_hz;
+    uint64_t ref_tsc; // a TSC reading and tsc::now_ns() at the same moment,
+    uint64_t ref_ns;  // so timestamps line up with the log
+    uint32_t points;
+    uint32_t reserved;
+};
+
+struct TraceRingHeader {
+    uint32_t cpu;
+    uint32_t count;
+};
+
+namespace trace {
+    static TraceRing rings[TRACE_MAX_CPUS];
+    static bool paused = false;
+
+    // Progress of the dump being written out by pump()
+    static bool dumping = false;
+    static uint32_t dump_cpu = 0;
+    static uint32_t dump_next = 0; // next record to write, counted from the oldest
+    static uint32_t dump_count = 0;
+
+    void record(const TracePoint* point, const TraceType type, const uint32_t value) {
+        if (paused) return;
+        TraceRing& ring = rings[0];
+
+        // An interrupt between reserving the slot and filling it records into
+        // the next slot, so records can be out of order by a few cycles
+        const uint32_t slot = __atomic_fetch_add(&ring.head, 1, __ATOMIC_RELAXED) & (TRACE_RING_SIZE - 1);
+        TraceRecord& r = ring.records[slot];
+        r.tsc = __builtin_ia32_rdtsc();
+        r.point = point ? static_cast<uint16_t>(point - __start_trace_points) : TRACE_NO_POINT;
+        r.type = type;
+        r.cpu = 0;
+        r.value = value;
+    }
+
+    // Rewrite a site between the NOP and a jump to its recording code. Kernel
+    // text is mapped read-only, so write protection is lifted for the write
+    // with interrupts off, which also keeps the half-written instruction from
+    // running on this CPU.
+    static bool patch(const TraceJump& jump, const bool enable) {
+        static constexpr uint8_t nop[5] = {0x0F, 0x1F, 0x44, 0x00, 0x00};
+        uint8_t insn[5];
+        if (enable) {
+            const int32_t rel = static_cast<int32_t>(jump.target - (jump.code + sizeof(insn)));
+            insn[0] = JMP_REL32;
+            memcpy(insn + 1, &rel, sizeof(rel));
+        } else {
+            memcpy(insn, nop, sizeof(insn));
+        }
+
+        auto* code = reinterpret_cast<uint8_t*>(jump.code);
+        if (memcmp(code, insn, sizeof(insn)) == 0) return false;
+
+        uint64_t cr0;
+        asm volatile("mov %%cr0, %0" : "=r"(cr0));
+        asm volatile("mov %0, %%cr0" : : "r"(cr0 & ~CR0_WP) : "memory");
+        for (uint8_t i = 0; i < sizeof(insn); i++) code[i] = insn[i];
+        asm volatile("mov %0, %%cr0" : : "r"(cr0) : "memory");
+        return true;
+    }
+
+    static uint32_t patch_matching(const char* name, const bool enable) {
+        const uint64_t flags = irq_save();
+        uint32_t changed = 0;
+        for (const TraceJump* jump = __start___tracepoints; jump < __stop___tracepoints; jump++) {
+            if (name && strcmp(jump->point->name, name) != 0) continue;
+            if (patch(*jump, enable)) changed++;
+        }
+
+        // Serialize so the prefetched old bytes are not executed
+        uint32_t eax, ebx, ecx, edx;
+        cpuid(0, 0, eax, ebx, ecx, edx);
+        irq_restore(flags);
+        return changed;
+    }
+
+    void set_enabled(const bool enable) {
+        patch_matching(nullptr, enable);
+    }
+
+    uint32_t set_enabled(const char* name, const bool enable) {
+        return patch_matching(name, enable);
+    }
+
+    /**
+     * Write the header of a CPU's ring and start on its records
+     */
+    static void begin_ring(const uint32_t cpu) {
+        const TraceRing& ring = rings[cpu];
+        dump_cpu = cpu;
+        dump_next = 0;
+        dump_count = ring.head < TRACE_RING_SIZE ? ring.head : TRACE_RING_SIZE;
+
+        const TraceRingHeader ring_header = {cpu, dump_count};
+        serial::write_hex(&ring_header, sizeof(ring_header));
+    }
+
+    /**
+     * Format, little-endian: a TraceHeader, the NUL-terminated name of each
+     * tracepoint in section order, then per CPU a TraceRingHeader followed by
+     * its records from oldest to newest
+     */
+    void dump() {
+        if (dumping) return;
+        paused = true;
+        dumping = true;
+
+        const uint32_t points = __stop_trace_points - __start_trace_points;
+        uint64_t records = 0;
+        for (const TraceRing& ring : rings) records += ring.head < TRACE_RING_SIZE ? ring.head : TRACE_RING_SIZE;
+        serial::printf("trace: %lu records, %u tracepoints\n", records, points);
+
+        const TraceHeader header = {
+            TRACE_FORMAT_VERSION,
+            TRACE_MAX_CPUS,
+            tsc::get_frequency(),
+            tsc::now_cycles(),
+            tsc::now_ns(),
+            points,
+            0
+        };
+        serial::write_hex(&header, sizeof(header));
+
+        for (uint32_t i = 0; i < points; i++) {
+            serial::write_hex(__start_trace_points[i].name, strlen(__start_trace_points[i].name) + 1);
+        }
+
+        begin_ring(0);
+    }
+
+    bool pump() {
+        if (!dumping) return false;
+        if (serial::tx_space() < TRACE_DUMP_CHUNK_HEX) return true;
+
+        while (dump_next == dump_count) {
+            rings[dump_cpu].head = 0;
+            if (dump_cpu + 1 == TRACE_MAX_CPUS) {
+                serial::print("trace: end\n");
+                dumping = false;
+                paused = false;
+                return false;
+            }
+            begin_ring(dump_cpu + 1);
+        }
+
+        // Oldest first: once the ring has wrapped that is the next slot to
+        // write, so a chunk stops at the end of the array and the next one
+        // carries on from the start
+        const TraceRing& ring = rings[dump_cpu];
+        const uint32_t slot = (ring.head - dump_count + dump_next) & (TRACE_RING_SIZE - 1);
+        uint32_t n = dump_count - dump_next;
+        if (n > TRACE_DUMP_CHUNK) n = TRACE_DUMP_CHUNK;
+        if (n > TRACE_RING_SIZE - slot) n = TRACE_RING_SIZE - slot;
+
+        serial::write_hex(&ring.records[slot], n * sizeof(TraceRecord));
+        dump_next += n;
+        return true;
+    }
+}
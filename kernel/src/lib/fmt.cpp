@@ -0,0 +1,88 @@
+#include "lib/fmt.hpp"
+
+#include "lib/string.hpp"
+
+#define PAD_CHUNK 16
+
+// Two ASCII digits for every value below 100, so decimal conversion needs one
+// division per pair of digits instead of one per digit
+static const char digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static void pad(fmt::detail::Writer& w, const char c, size_t n) {
+    char chunk[PAD_CHUNK];
+    __builtin_memset(chunk, c, sizeof(chunk));
+    for (; n > PAD_CHUNK; n -= PAD_CHUNK) w.put(chunk, PAD_CHUNK);
+    w.put(chunk, n);
+}
+
+// Write text padded to the field width. sign is printed before zero padding.
+static void write_padded(fmt::detail::Writer& w, const fmt::detail::Spec spec, const char* sign, const char* text, const size_t len) {
+    const size_t sign_len = sign ? 1 : 0;
+    const size_t fill = spec.width > len + sign_len ? spec.width - len - sign_len : 0;
+
+    if (spec.left) {
+        if (sign) w.put(sign, 1);
+        w.put(text, len);
+        pad(w, ' ', fill);
+    } else if (spec.zero) {
+        if (sign) w.put(sign, 1);
+        pad(w, '0', fill);
+        w.put(text, len);
+    } else {
+        pad(w, ' ', fill);
+        if (sign) w.put(sign, 1);
+        w.put(text, len);
+    }
+}
+
+namespace fmt::detail {
+    void write_integer(Writer& w, const Spec spec, uint64_t magnitude, const bool negative) {
+        char buf[20];
+        char* const end = buf + sizeof(buf);
+        char* s = end;
+
+        if (spec.conv == 'x' || spec.conv == 'X' || spec.conv == 'p') {
+            // %p stays upper-case to match vformat
+            const char* digits = spec.conv == 'x' ? "0123456789abcdef" : "0123456789ABCDEF";
+            do {
+                *--s = digits[magnitude & 0xF];
+                magnitude >>= 4;
+            } while (magnitude);
+        } else {
+            while (magnitude >= 100) {
+                const uint32_t pair = magnitude % 100 * 2;
+                magnitude /= 100;
+                *--s = digit_pairs[pair + 1];
+                *--s = digit_pairs[pair];
+            }
+            if (magnitude >= 10) {
+                *--s = digit_pairs[magnitude * 2 + 1];
+                *--s = digit_pairs[magnitude * 2];
+            } else {
+                *--s = static_cast<char>('0' + magnitude);
+            }
+        }
+
+        write_padded(w, spec, negative ? "-" : nullptr, s, end - s);
+    }
+
+    void write_string(Writer& w, const Spec spec, const char* str) {
+        if (!str) str = "(null)";
+        write_padded(w, spec, nullptr, str, strlen(str));
+    }
+
+    void write_char(Writer& w, Spec spec, const char c) {
+        spec.zero = false;
+        write_padded(w, spec, nullptr, &c, 1);
+    }
+}
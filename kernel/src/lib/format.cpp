@@ -4,16 +4,32 @@
 #include <cwchar>
 #include <cstdint>
 
-#include "driver/serial.hpp"
+#include "lib/string.hpp"
 #include "memory/mem.hpp"
 
-static void simple_outputchar(char** str, const char c) {
-    if (str) {
-        **str = c;
-        ++(*str);
-    } else {
-        serial::putchar(c);
+#define FORMAT_STACK_SIZE 256
+
+// Destination of formatted output: a sink if set, otherwise a buffer.
+// Characters past end are counted but dropped, a null end means unbounded.
+struct FormatOut {
+    char* pos;
+    char* end;
+    const FormatSink* sink;
+};
+
+static void emit(FormatOut* out, const char* data, size_t len) {
+    if (out->sink) {
+        out->sink->write(out->sink->ctx, data, len);
+        return;
     }
+
+    if (out->end && len > static_cast<size_t>(out->end - out->pos)) len = out->end - out->pos;
+    memcpy(out->pos, data, len);
+    out->pos += len;
+}
+
+static void simple_outputchar(FormatOut* out, const char c) {
+    emit(out, &c, 1);
 }
 
 enum flags {
@@ -21,12 +37,11 @@ enum flags {
     PAD_RIGHT = 2,
 };
 
-static int prints(char** out, const char* string, int width, int flags) {
+static int prints(FormatOut* out, const char* string, int width, int flags) {
     int pc = 0, padchar = ' ';
+    const int len = strlen(string);
 
     if (width > 0) {
-        int len = 0;
-        for (const char* ptr = string; *ptr; ++ptr) ++len;
         if (len >= width) width = 0;
         else width -= len;
         if (flags & PAD_ZERO) padchar = '0';
@@ -37,10 +52,8 @@ static int prints(char** out, const char* string, int width, int flags) {
             ++pc;
         }
     }
-    for (; *string; ++string) {
-        simple_outputchar(out, *string);
-        ++pc;
-    }
+    emit(out, string, len);
+    pc += len;
     for (; width > 0; --width) {
         simple_outputchar(out, padchar);
         ++pc;
@@ -52,7 +65,7 @@ static int prints(char** out, const char* string, int width, int flags) {
 #define PRINT_BUF_LEN 64
 
 static int simple_outputi(
-    char** out,
+    FormatOut* out,
     const int64_t i,
     const int base,
     const int sign,
@@ -99,7 +112,7 @@ static int simple_outputi(
     return pc + prints(out, s, width, flags);
 }
 
-int vformat(char** out, const char* format, va_list ap) {
+static int format_impl(FormatOut* out, const char* format, va_list ap) {
     int width, flags;
     int pc = 0;
     char scr[2];
@@ -321,30 +334,68 @@ int vformat(char** out, const char* format, va_list ap) {
             }
         } else {
         out:
-            simple_outputchar(out, *format);
-            ++pc;
+            // Copy everything up to the next conversion in one go
+            const char* run = format;
+            while (format[1] && format[1] != '%') ++format;
+            emit(out, run, format - run + 1);
+            pc += format - run + 1;
         }
     }
     return pc;
 }
 
+int vformat(char** out, const char* format, va_list ap) {
+    FormatOut dst = {*out, nullptr, nullptr};
+    const int written = format_impl(&dst, format, ap);
+    *out = dst.pos;
+    return written;
+}
+
+int vformat_to(char* buf, const size_t cap, const char* format, va_list ap) {
+    FormatOut dst = {buf, buf + (cap ? cap - 1 : 0), nullptr};
+    const int written = format_impl(&dst, format, ap);
+    if (cap) *dst.pos = '\0';
+    return written;
+}
+
+int vformat_to(const FormatSink& sink, const char* format, va_list ap) {
+    FormatOut dst = {nullptr, nullptr, &sink};
+    return format_impl(&dst, format, ap);
+}
+
+int format_to(const FormatSink& sink, const char* format, ...) {
+    va_list list;
+    va_start(list, format);
+    const int written = vformat_to(sink, format, list);
+    va_end(list);
+    return written;
+}
+
+int format_to(char* buf, const size_t cap, const char* format, ...) {
+    va_list list;
+    va_start(list, format);
+    const int written = vformat_to(buf, cap, format, list);
+    va_end(list);
+    return written;
+}
+
 char* vformat(const char* fmt, va_list ap) {
-    size_t cap = 128;
-    for (;;) {
-        const auto buf = static_cast<char *>(malloc(cap));
-        if (!buf) return nullptr;
-        char* p = buf;
-        va_list ap2;
-        va_copy(ap2, ap);
-        const int written = vformat(&p, fmt, ap2);
-        va_end(ap2);
-        if (written < static_cast<int>(cap)) {
-            *p = '\0';
-            return buf;
-        }
-        free(buf);
-        cap = static_cast<size_t>(written) + 1;
+    // Most strings fit on the stack, so only long ones are formatted twice
+    char stack[FORMAT_STACK_SIZE];
+    va_list ap2;
+    va_copy(ap2, ap);
+    const int written = vformat_to(stack, sizeof(stack), fmt, ap2);
+    va_end(ap2);
+
+    const auto buf = static_cast<char*>(malloc(written + 1));
+    if (!buf) return nullptr;
+
+    if (written < FORMAT_STACK_SIZE) {
+        memcpy(buf, stack, written + 1);
+    } else {
+        vformat_to(buf, written + 1, fmt, ap);
     }
+    return buf;
 }
 
 char* format(const char* format, ...) {
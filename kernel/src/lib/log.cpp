@@ -2,13 +2,16 @@
 
 #include <cstdarg>
 
+#include "driver/pic.hpp"
 #include "driver/screen.hpp"
 #include "driver/serial.hpp"
+#include "driver/tsc.hpp"
 #include "lib/format.hpp"
-#include "memory/mem.hpp"
+#include "lib/ring.hpp"
 
-#define LOG_LINE_MAX    256
-#define LOG_MAX_LINES   512
+#define LOG_FLUSH_THRESHOLD (LOG_MAX_LINES / 2)
+#define LOG_FLUSH_BATCH     8
+#define CONSOLE_LINE_HEIGHT 8
 
 static const char* level_names[] = {
     "DEBUG", "INFO", "WARN", "ERROR", "FATAL"
@@ -22,31 +25,23 @@ static const uint32_t level_colors[] = {
     0xFF00FF  // FATAL - magenta
 };
 
-struct LogEntry {
-    uint64_t timestamp;
-    LogLevel level;
-    uint16_t len;
-    char     payload[LOG_LINE_MAX];
-} __attribute__((packed, aligned(8)));
+static MpscRing<LogRecord, LOG_MAX_LINES> log_ring;
+static uint64_t reported_dropped = 0;
+static bool flushing = false;
+static bool sync_mode = false;
+static bool console_enabled = true;
+static uint32_t console_line = 0;
 
-static LogEntry log_buffer[LOG_MAX_LINES];
-static uint32_t log_buffer_head = 0;
-static uint32_t log_buffer_tail = 0;
-
-static void push_log_record(const LogLevel level, const char*) {
-    uint32_t pos = log_buffer_head + 1;
-    uint32_t log_index = log_buffer_head + 1 & (LOG_MAX_LINES - 1);
-}
-
-int line = 0;
-void Logger::vlog(const LogLevel level, const char* fmt, va_list ap) const {
-    if (level < log_level) return;
+struct LogSink {
+    void (*write)(const LogRecord& record);
+    void (*done)(); // after each batch, may be null
+};
 
-    char* body = vformat(fmt, ap);
-    if (!body) return;
+static void serial_write(const LogRecord& record) {
+    if (!serial::available()) return;
 
     const char* prefix;
-    switch (level) {
+    switch (record.level) {
         case LOG_LEVEL_DEBUG: prefix = "\033[36m"; break; // cyan
         case LOG_LEVEL_INFO:  prefix = "\033[32m"; break; // green
         case LOG_LEVEL_WARN:  prefix = "\033[33m"; break; // yellow
@@ -55,16 +50,100 @@ void Logger::vlog(const LogLevel level, const char* fmt, va_list ap) const {
         default: prefix = ""; break;
     }
 
-    if (serial::available()) {
-        serial::printf("%s[%s] %s\033[0m\n", prefix, level_names[level], body);
+    serial::printf(
+        "%s[%lu.%06lu] [%s] %s\033[0m\n",
+        prefix,
+        record.timestamp / 1000000000,
+        record.timestamp / 1000 % 1000000,
+        level_names[record.level],
+        record.text
+    );
+}
+
+static void console_write(const LogRecord& record) {
+    if (!console_enabled || framebuffer.size == 0) return;
+
+    // Wrap back to the top once the screen is full
+    if ((console_line + 1) * CONSOLE_LINE_HEIGHT > framebuffer.height) {
+        screen::clear();
+        console_line = 0;
     }
 
-    const char* formatted = format("[%s] %s\n", level_names[level], body);
+    char line[LOG_LINE_MAX + 8];
+    format_to(line, sizeof(line), "[%s] %s", level_names[record.level], record.text);
+    screen::draw(line, 0, console_line++ * CONSOLE_LINE_HEIGHT, 1, level_colors[record.level]);
+}
+
+static void console_done() {
+    if (console_enabled && framebuffer.size != 0) screen::flush();
+}
+
+static constexpr LogSink sinks[] = {
+    {serial_write, nullptr},
+    {console_write, console_done},
+};
+
+static void write_record(const LogRecord& record) {
+    for (const LogSink& sink : sinks) sink.write(record);
+}
+
+void Logger::flush() const {
+    if (flushing) return;
+    flushing = true;
+
+    LogRecord batch[LOG_FLUSH_BATCH];
+    uint32_t total = 0;
+    for (uint32_t n; (n = log_ring.pop_batch(batch, LOG_FLUSH_BATCH)) > 0; total += n) {
+        for (uint32_t i = 0; i < n; i++) write_record(batch[i]);
+    }
 
-    screen::draw(formatted, 0, line++ * 8 * 1, 1, level_colors[level]);
-    screen::flush();
+    const uint64_t dropped = log_ring.get_dropped();
+    if (dropped != reported_dropped) {
+        LogRecord record = {tsc::now_ns(), LOG_LEVEL_WARN, 0, {}};
+        record.len = format_to(record.text, sizeof(record.text), "log: %lu records dropped", dropped - reported_dropped);
+        reported_dropped = dropped;
+        write_record(record);
+        total++;
+    }
+
+    if (total) {
+        for (const LogSink& sink : sinks) {
+            if (sink.done) sink.done();
+        }
+    }
+
+    flushing = false;
+}
+
+void Logger::set_sync(const bool enabled) {
+    sync_mode = enabled;
+}
+
+void Logger::set_console(const bool enabled) {
+    console_enabled = enabled;
+}
+
+uint64_t Logger::get_dropped() const {
+    return log_ring.get_dropped();
+}
+
+void Logger::submit(const LogLevel level, LogRecord& record) const {
+    record.timestamp = tsc::now_ns();
+    record.level = level;
+    log_ring.push(record);
+
+    if (level == LOG_LEVEL_FATAL || sync_mode || (log_ring.size() >= LOG_FLUSH_THRESHOLD && !in_irq())) {
+        flush();
+    }
+}
+
+void Logger::vlog(const LogLevel level, const char* fmt, va_list ap) const {
+    if (level < log_level) return;
 
-    free(body);
+    LogRecord record;
+    const int len = vformat_to(record.text, sizeof(record.text), fmt, ap);
+    record.len = len < LOG_LINE_MAX ? len : LOG_LINE_MAX - 1;
+    submit(level, record);
 }
 
 void Logger::log(const LogLevel level, const char* fmt, ...) const {
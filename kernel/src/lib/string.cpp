@@ -1,24 +1,173 @@
 #include "lib/string.hpp"
 
+#include <cstdint>
+
+#define WORD_SIZE sizeof(uint64_t)
+#define ONES      0x0101010101010101ull
+#define HIGHS     0x8080808080808080ull
+
+// Word loads are allowed to alias the chars they are read from
+typedef uint64_t __attribute__((may_alias)) word_t;
+
+// Sets the high bit of each zero byte of v. The borrow can also flag a 0x01
+// byte above a zero, so only the lowest flag is exact, which is all the
+// scans below use.
+static inline uint64_t zero_bytes(const uint64_t v) {
+    return (v - ONES) & ~v & HIGHS;
+}
+
+static inline size_t first_flagged(const uint64_t mask) {
+    return __builtin_ctzll(mask) / 8;
+}
+
+static inline size_t word_offset(const void* ptr) {
+    return reinterpret_cast<uintptr_t>(ptr) & (WORD_SIZE - 1);
+}
+
+// The aligned word holding ptr, which never spans two pages
+static inline const word_t* align_down(const void* ptr) {
+    return reinterpret_cast<const word_t*>(reinterpret_cast<uintptr_t>(ptr) & ~(WORD_SIZE - 1));
+}
+
+// Ones in the bytes of the aligned word that come before ptr, so OR-ing it in
+// hides them from zero_bytes()
+static inline uint64_t head_mask(const void* ptr) {
+    return (1ull << word_offset(ptr) * 8) - 1;
+}
+
 size_t strlen(const char* str) {
-    size_t len = 0;
-    while (str[len]) len++;
-    return len;
+    const word_t* w = align_down(str);
+    uint64_t mask = zero_bytes(*w | head_mask(str));
+    while (!mask) mask = zero_bytes(*++w);
+
+    return reinterpret_cast<const char*>(w) + first_flagged(mask) - str;
 }
 
-char* strcpy(char* destination, const char* source) {
-    for (size_t i = 0; source[i] != '\0'; i++) {
-        destination[i] = source[i];
+size_t strnlen(const char* str, const size_t max) {
+    if (!max) return 0;
+
+    const word_t* w = align_down(str);
+    uint64_t mask = zero_bytes(*w | head_mask(str));
+    for (size_t scanned = WORD_SIZE - word_offset(str); !mask && scanned < max; scanned += WORD_SIZE) {
+        mask = zero_bytes(*++w);
+    }
+    if (!mask) return max;
+
+    const size_t len = reinterpret_cast<const char*>(w) + first_flagged(mask) - str;
+    return len < max ? len : max;
+}
+
+void* memchr(const void* ptr, const int value, const size_t count) {
+    if (!count) return nullptr;
+
+    // Matching bytes become zero after xor-ing with the value in every byte
+    const auto start = static_cast<const uint8_t*>(ptr);
+    const uint64_t pattern = ONES * static_cast<uint8_t>(value);
+    const word_t* w = align_down(start);
+    uint64_t mask = zero_bytes((*w ^ pattern) | head_mask(start));
+    for (size_t scanned = WORD_SIZE - word_offset(start); !mask && scanned < count; scanned += WORD_SIZE) {
+        mask = zero_bytes(*++w ^ pattern);
+    }
+    if (!mask) return nullptr;
+
+    const uint8_t* found = reinterpret_cast<const uint8_t*>(w) + first_flagged(mask);
+    return found < start + count ? const_cast<uint8_t*>(found) : nullptr;
+}
+
+char* strchr(const char* str, const int ch) {
+    // Stop at whichever comes first of the character and the terminator
+    const uint64_t pattern = ONES * static_cast<uint8_t>(ch);
+    const uint64_t head = head_mask(str);
+    const word_t* w = align_down(str);
+    uint64_t mask = zero_bytes(*w | head) | zero_bytes((*w ^ pattern) | head);
+    while (!mask) {
+        const uint64_t v = *++w;
+        mask = zero_bytes(v) | zero_bytes(v ^ pattern);
     }
 
+    const char* found = reinterpret_cast<const char*>(w) + first_flagged(mask);
+    return *found == static_cast<char>(ch) ? const_cast<char*>(found) : nullptr;
+}
+
+int strcmp(const char* a, const char* b) {
+    // Strings at the same offset within a word can be compared a word at a
+    // time once aligned; otherwise one of the loads would be unaligned
+    if (word_offset(a) == word_offset(b)) {
+        for (; word_offset(a) && *a && *a == *b; a++, b++) {}
+
+        if (!word_offset(a)) {
+            const word_t* wa = reinterpret_cast<const word_t*>(a);
+            const word_t* wb = reinterpret_cast<const word_t*>(b);
+            for (; *wa == *wb && !zero_bytes(*wa); wa++, wb++) {}
+            a = reinterpret_cast<const char*>(wa);
+            b = reinterpret_cast<const char*>(wb);
+        }
+    }
+
+    for (; *a && *a == *b; a++, b++) {}
+    return static_cast<unsigned char>(*a) - static_cast<unsigned char>(*b);
+}
+
+int strncmp(const char* a, const char* b, size_t count) {
+    if (word_offset(a) == word_offset(b)) {
+        for (; count && word_offset(a) && *a && *a == *b; a++, b++, count--) {}
+
+        if (!word_offset(a)) {
+            const word_t* wa = reinterpret_cast<const word_t*>(a);
+            const word_t* wb = reinterpret_cast<const word_t*>(b);
+            for (; count >= WORD_SIZE && *wa == *wb && !zero_bytes(*wa); wa++, wb++, count -= WORD_SIZE) {}
+            a = reinterpret_cast<const char*>(wa);
+            b = reinterpret_cast<const char*>(wb);
+        }
+    }
+
+    for (; count && *a && *a == *b; a++, b++, count--) {}
+    return count ? static_cast<unsigned char>(*a) - static_cast<unsigned char>(*b) : 0;
+}
+
+// Copy source including the terminator
+// @return the terminator written to destination
+static char* copy_string(char* destination, const char* source) {
+    if (word_offset(destination) == word_offset(source)) {
+        for (; word_offset(source); destination++, source++) {
+            if (!(*destination = *source)) return destination;
+        }
+
+        auto wd = reinterpret_cast<word_t*>(destination);
+        auto ws = reinterpret_cast<const word_t*>(source);
+        for (; !zero_bytes(*ws); wd++, ws++) *wd = *ws;
+        destination = reinterpret_cast<char*>(wd);
+        source = reinterpret_cast<const char*>(ws);
+    }
+
+    while ((*destination = *source)) {
+        destination++;
+        source++;
+    }
+    return destination;
+}
+
+char* strcpy(char* destination, const char* source) {
+    copy_string(destination, source);
+    return destination;
+}
+
+char* strncpy(char* destination, const char* source, const size_t count) {
+    const size_t len = strnlen(source, count);
+    __builtin_memcpy(destination, source, len);
+    __builtin_memset(destination + len, 0, count - len);
     return destination;
 }
 
 char* strcat(char* destination, const char* source) {
-    destination[strlen(destination)] = source[0];
+    copy_string(destination + strlen(destination), source);
     return destination;
 }
 
 char* strncat(char* destination, const char* source, const size_t count) {
-    return destination + strlen(destination) - count;
-}
\ No newline at end of file
+    char* end = destination + strlen(destination);
+    const size_t len = strnlen(source, count);
+    __builtin_memcpy(end, source, len);
+    end[len] = '\0';
+    return destination;
+}
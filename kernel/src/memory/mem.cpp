@@ -6,6 +6,7 @@
 
 #include "driver/limine/limine_requests.hpp"
 #include "kernel/system.hpp"
+#include "kernel/trace.hpp"
 
 static inline uint64_t hhdm_offset = limine_requests::hhdm_request.response->offset;
 
@@ -222,6 +223,7 @@ void* malloc(const size_t size) {
         panic("Out of memory!\n");
     }
     heap_ptr = hhdm_offset + p + asize;
+    TRACE_COUNTER("heap_used", static_cast<uint32_t>(p + asize - heap_start));
     return p;
 }
 
@@ -236,3 +238,9 @@ void* realloc(void* ptr, const size_t size) {
     (void)size;
     return nullptr;
 }
+
+namespace mem {
+    size_t get_heap_used() {
+        return heap_ptr - heap_start;
+    }
+}
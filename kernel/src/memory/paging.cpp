@@ -3,16 +3,26 @@
 #include "driver/limine/limine.h"
 #include "driver/limine/limine_requests.hpp"
 #include "../../include/memory/mem.hpp"
+#include "kernel/system.hpp"
 
 namespace paging {
     constexpr uint64_t PAGE_SIZE = 0x1000;
 
     constexpr uint64_t PTE_PRESENT = 1ull << 0;
     constexpr uint64_t PTE_WRITE = 1ull << 1;
+    constexpr uint64_t PTE_PWT = 1ull << 3;
+    constexpr uint64_t PTE_PCD = 1ull << 4;
     constexpr uint64_t PTE_PS = 1ull << 7;
+    constexpr uint64_t PTE_ADDR_MASK = 0x000FFFFFFFFFF000ull;
 
     constexpr size_t PAGE_TABLE_ENTRIES = 512;
 
+    // Page tables for MMIO mappings come from the kernel image, as there is no
+    // physical page allocator yet
+    constexpr size_t MMIO_TABLE_POOL = 16;
+    alignas(PAGE_SIZE) static uint64_t mmio_tables[MMIO_TABLE_POOL][PAGE_TABLE_ENTRIES];
+    static size_t mmio_tables_used = 0;
+
     uint64_t g_kernel_phys_base = 0;
     uint64_t g_kernel_virt_base = 0;
     uint64_t g_kernel_size = 0;
@@ -31,6 +41,51 @@ namespace paging {
 
     }
 
+    static uint64_t* next_table(uint64_t* table, const size_t index, const uint64_t hhdm) {
+        if (table[index] & PTE_PRESENT) {
+            // A large page already covers this address
+            if (table[index] & PTE_PS) return nullptr;
+            return reinterpret_cast<uint64_t*>(hhdm + (table[index] & PTE_ADDR_MASK));
+        }
+
+        if (mmio_tables_used == MMIO_TABLE_POOL) panic("paging: out of MMIO page tables");
+
+        uint64_t* new_table = mmio_tables[mmio_tables_used++];
+        const limine_executable_address_response* exec = limine_requests::executable_addr_request.response;
+        const uint64_t phys = reinterpret_cast<uint64_t>(new_table) - exec->virtual_base + exec->physical_base;
+
+        table[index] = phys | PTE_PRESENT | PTE_WRITE;
+        return new_table;
+    }
+
+    void* map_mmio(const uint64_t phys, const size_t size) {
+        const uint64_t hhdm = limine_requests::hhdm_request.response->offset;
+        const uint64_t start = phys & ~(PAGE_SIZE - 1);
+        const uint64_t end = (phys + size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+        uint64_t cr3;
+        asm volatile("mov %%cr3, %0" : "=r"(cr3));
+        auto* pml4 = reinterpret_cast<uint64_t*>(hhdm + (cr3 & PTE_ADDR_MASK));
+
+        for (uint64_t page = start; page < end; page += PAGE_SIZE) {
+            const uint64_t virt = hhdm + page;
+
+            uint64_t* table = pml4;
+            for (uint8_t level = 3; level > 0 && table; level--) {
+                table = next_table(table, (virt >> (12 + 9 * level)) & 0x1FF, hhdm);
+            }
+            if (!table) continue;
+
+            uint64_t& pte = table[(virt >> 12) & 0x1FF];
+            if (pte & PTE_PRESENT) continue;
+
+            pte = page | PTE_PRESENT | PTE_WRITE | PTE_PWT | PTE_PCD;
+            asm volatile("invlpg (%0)" : : "r"(virt) : "memory");
+        }
+
+        return reinterpret_cast<void*>(hhdm + phys);
+    }
+
     void init() {
         g_kernel_phys_base = limine_requests::executable_addr_request.response->physical_base;
         g_kernel_virt_base = reinterpret_cast<uint64_t>(&kernel_start);
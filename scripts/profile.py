@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""Turn a profile dumped over serial into folded stacks for flamegraph.pl.
+
+Boot with prof=HZ (and profstack for call stacks), press F3 or send 'f' over
+serial to dump, then:
+
+    scripts/profile.py serial.log > tetros.folded
+    flamegraph.pl tetros.folded > tetros.svg
+
+Addresses are resolved against the kernel ELF with nm. The last dump in the
+log is used unless --all is given.
+"""
+
+import argparse
+import bisect
+import subprocess
+import sys
+from collections import Counter
+
+FORMAT_VERSION = 1
+
+
+def read_dumps(lines):
+    """Yield the hex payload of every complete 'profile:' block."""
+    payload = None
+    for line in lines:
+        line = line.strip()
+        if line.startswith("profile: end"):
+            if payload is not None:
+                yield bytes.fromhex("".join(payload))
+            payload = None
+        elif line.startswith("profile: "):
+            payload = []
+        elif payload is not None:
+            payload.append(line)
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def varint(self):
+        value = shift = 0
+        while True:
+            byte = self.data[self.pos]
+            self.pos += 1
+            value |= (byte & 0x7F) << shift
+            shift += 7
+            if byte < 0x80:
+                return value
+
+
+def decode(data):
+    """Return (period_ms, dropped, samples), each sample a leaf-first address list."""
+    r = Reader(data)
+    version = r.varint()
+    if version != FORMAT_VERSION:
+        sys.exit(f"unsupported profile format version {version}")
+
+    period_ms, count, dropped = r.varint(), r.varint(), r.varint()
+    previous = []
+    samples = []
+    for _ in range(count):
+        frames = []
+        for i in range(r.varint()):
+            zigzag = r.varint()
+            delta = (zigzag >> 1) ^ -(zigzag & 1)
+            base = previous[i] if i < len(previous) else 0
+            frames.append((base + delta) & 0xFFFFFFFFFFFFFFFF)
+        previous[:len(frames)] = frames
+        samples.append(frames)
+    return period_ms, dropped, samples
+
+
+class Symbols:
+    def __init__(self, elf):
+        out = subprocess.run(["nm", "-n", "-C", "--defined-only", elf],
+                             check=True, capture_output=True, text=True).stdout
+        self.addresses = []
+        self.names = []
+        for line in out.splitlines():
+            parts = line.split(" ", 2)
+            if len(parts) == 3 and parts[1] in "tTwW":
+                self.addresses.append(int(parts[0], 16))
+                self.names.append(parts[2])
+
+    def resolve(self, address):
+        i = bisect.bisect_right(self.addresses, address) - 1
+        if i < 0:
+            return f"0x{address:x}"
+        # Strip parameter lists, flamegraphs read better with bare names
+        name = self.names[i]
+        paren = name.find("(")
+        return name[:paren] if paren > 0 else name
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("log", help="serial output containing a profile dump, - for stdin")
+    parser.add_argument("--elf", default="build/tetros", help="kernel image the profile was taken from")
+    parser.add_argument("--all", action="store_true", help="merge every dump in the log instead of the last")
+    args = parser.parse_args()
+
+    with (sys.stdin if args.log == "-" else open(args.log, errors="replace")) as f:
+        dumps = list(read_dumps(f))
+    if not dumps:
+        sys.exit("no profile dump found")
+
+    symbols = Symbols(args.elf)
+    folded = Counter()
+    total = dropped = 0
+    for data in dumps if args.all else dumps[-1:]:
+        period_ms, lost, samples = decode(data)
+        dropped += lost
+        for frames in samples:
+            # Return addresses point after the call, step back into it
+            names = [symbols.resolve(a if i == 0 else a - 1) for i, a in enumerate(frames)]
+            folded[";".join(reversed(names))] += 1
+        total += len(samples)
+
+    for stack, count in folded.most_common():
+        print(f"{stack} {count}")
+    every = f"every {period_ms} ms" if period_ms else "on PMU events"
+    print(f"{total} samples {every}, {dropped} dropped", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -3,12 +3,14 @@ set -e
 
 debug=0
 gdb=0
+serial_log=""
 
 while test $# != 0
 do
     case "$1" in
     -d|--debug) debug=1 ;;
     --gdb) gdb=1 ;;
+    -l|--log) serial_log="$2"; shift ;;
     --) shift; break;;
     *)  break ;;
     esac
@@ -34,10 +36,17 @@ if [ "$gdb" -eq 1 ]; then
     QEMU_ARGS="-s -S $QEMU_ARGS"
 fi
 
+# Keep a copy of the serial output, e.g. for scripts/profile.py
+if [ -n "$serial_log" ]; then
+    SERIAL_ARGS="-chardev stdio,id=serial0,mux=on,logfile=$serial_log -serial chardev:serial0 -mon chardev=serial0"
+else
+    SERIAL_ARGS="-serial mon:stdio"
+fi
+
 exec qemu-system-x86_64 \
     -cdrom "$BUILD_DIR/tetros.iso" \
     -net none \
-    -serial mon:stdio \
+    $SERIAL_ARGS \
     -m 4G \
     -audiodev pa,id=speaker \
     -machine pcspk-audiodev=speaker \
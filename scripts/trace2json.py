@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+"""Convert a trace dumped over serial into Chrome trace JSON.
+
+Boot with trace (or enable tracing some other way), press F4 or send 't' over
+serial to dump, then:
+
+    scripts/trace2json.py serial.log > tetros.json
+
+and open the result in https://ui.perfetto.dev or chrome://tracing. The last
+dump in the log is used.
+"""
+
+import argparse
+import json
+import re
+import struct
+import sys
+
+FORMAT_VERSION = 1
+NO_POINT = 0xFFFF
+TYPES = {0: "B", 1: "E", 2: "C"}
+
+HEADER = struct.Struct("<IIQQQII")
+RING_HEADER = struct.Struct("<II")
+RECORD = struct.Struct("<QHBBI")
+HEX_LINE = re.compile(r"[0-9a-f]+")
+
+
+def read_dumps(lines):
+    """Yield the hex payload of every complete 'trace:' block.
+
+    The kernel writes a dump out over many main loop iterations, so log lines
+    can land in the middle of it. Only lines of hex digits are taken.
+    """
+    payload = None
+    for line in lines:
+        line = line.strip()
+        if line.startswith("trace: end"):
+            if payload is not None:
+                yield bytes.fromhex("".join(payload))
+            payload = None
+        elif line.startswith("trace: "):
+            payload = []
+        elif payload is not None and HEX_LINE.fullmatch(line):
+            payload.append(line)
+
+
+def decode(data):
+    """Return a list of Chrome trace events."""
+    version, cpus, tsc_hz, ref_tsc, ref_ns, points, _ = HEADER.unpack_from(data)
+    if version != FORMAT_VERSION:
+        sys.exit(f"unsupported trace format version {version}")
+    pos = HEADER.size
+
+    names = []
+    for _ in range(points):
+        end = data.index(b"\0", pos)
+        names.append(data[pos:end].decode(errors="replace"))
+        pos = end + 1
+
+    # Timestamps in µs on the kernel's tsc::now_ns() clock
+    def micros(tsc):
+        return (ref_ns + (tsc - ref_tsc) * 1_000_000_000 / tsc_hz) / 1000
+
+    events = []
+    for _ in range(cpus):
+        cpu, count = RING_HEADER.unpack_from(data, pos)
+        pos += RING_HEADER.size
+
+        # The ring may have overwritten the begin of a span that is still in
+        # it, so ends are matched against a stack and unmatched ones dropped
+        stack = []
+        ts = 0
+        for _ in range(count):
+            tsc, point, kind, _, value = RECORD.unpack_from(data, pos)
+            pos += RECORD.size
+            ts = micros(tsc)
+            phase = TYPES.get(kind)
+            name = names[point] if point != NO_POINT and point < len(names) else f"point {point}"
+            if phase == "E":
+                if stack and stack[-1] == name:
+                    events.append({"name": stack.pop(), "ph": "E", "ts": ts, "pid": 1, "tid": cpu})
+                continue
+
+            event = {"name": name, "ph": phase, "ts": ts, "pid": 1, "tid": cpu}
+            if phase == "C":
+                event["args"] = {"value": value}
+            elif phase == "B":
+                event["args"] = {"arg": value}
+                stack.append(name)
+            else:
+                continue
+            events.append(event)
+
+        # Close spans still open when the trace was dumped
+        while stack:
+            events.append({"name": stack.pop(), "ph": "E", "ts": ts, "pid": 1, "tid": cpu})
+
+    return events
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("log", help="serial output containing a trace dump, - for stdin")
+    args = parser.parse_args()
+
+    with (sys.stdin if args.log == "-" else open(args.log, errors="replace")) as f:
+        dumps = list(read_dumps(f))
+    if not dumps:
+        sys.exit("no trace dump found")
+
+    events = decode(dumps[-1])
+    json.dump({"traceEvents": events, "displayTimeUnit": "ns"}, sys.stdout)
+    print()
+    print(f"{len(events)} events", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()